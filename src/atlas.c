@@ -0,0 +1,365 @@
+/*
+ * atlas.c <z64.me>
+ *
+ * every image the game uses is packed into a single
+ * texture atlas at load time, so drawing never has
+ * to switch between textures
+ *
+ */
+
+#include "common.h"
+#include "stb_image.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define ATLAS_W  1024 /* atlas width; height is derived while packing */
+
+struct Image
+{
+	struct Image *next;     /* next in list */
+	uint32_t     *pix;      /* rgba8888 pixels (until atlas is built) */
+	SDL_Rect      rect;     /* location within atlas */
+};
+
+struct Atlas
+{
+	struct Image *imageList; /* linked list of images */
+	SDL_Texture  *tex;       /* texture containing every image */
+	uint32_t     *pix;       /* rgba8888 copy of texture contents */
+	uint16_t     *span;      /* span table for texture contents */
+	int           w;         /* dimensions of atlas */
+	int           h;
+};
+
+/* sort images tallest first, for shelf packing */
+static int ImageCompareHeight(const void *a, const void *b)
+{
+	const struct Image *imgA = *(const struct Image**)a;
+	const struct Image *imgB = *(const struct Image**)b;
+	
+	if (imgA->rect.h != imgB->rect.h)
+		return imgB->rect.h - imgA->rect.h;
+	
+	return imgB->rect.w - imgA->rect.w;
+}
+
+/* arrange images in rows ("shelves") from tallest to shortest,
+ * filling in each image's rectangle and the atlas dimensions
+ */
+static void AtlasPack(struct Atlas *atlas)
+{
+	struct Image **sorted;
+	struct Image *img;
+	int shelfY = 0;
+	int shelfH = 0;
+	int x = 0;
+	int num = 0;
+	int i;
+	
+	assert(atlas);
+	
+	for (img = atlas->imageList; img; img = img->next)
+		++num;
+	
+	if (!(sorted = malloc(num * sizeof(*sorted))))
+		FlappyFatal("memory error");
+	
+	for (i = 0, img = atlas->imageList; img; img = img->next)
+		sorted[i++] = img;
+	
+	qsort(sorted, num, sizeof(*sorted), ImageCompareHeight);
+	
+	atlas->w = ATLAS_W;
+	for (i = 0; i < num; ++i)
+	{
+		img = sorted[i];
+		
+		if (img->rect.w > atlas->w)
+			FlappyFatal("image too wide for atlas (%d pixels)", img->rect.w);
+		
+		/* start a new shelf */
+		if (x + img->rect.w > atlas->w)
+		{
+			shelfY += shelfH;
+			shelfH = 0;
+			x = 0;
+		}
+		
+		img->rect.x = x;
+		img->rect.y = shelfY;
+		x += img->rect.w;
+		
+		if (img->rect.h > shelfH)
+			shelfH = img->rect.h;
+	}
+	atlas->h = shelfY + shelfH;
+	
+	free(sorted);
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate an empty atlas; images are added to it and then it is built */
+struct Atlas *AtlasNew(struct Flappy *game)
+{
+	struct Atlas *atlas = calloc(1, sizeof(*atlas));
+	
+	if (!atlas)
+		return 0;
+	
+	return atlas;
+	
+	(void)game;
+}
+
+/* pack every image added so far into one texture */
+void AtlasBuild(struct Flappy *game, struct Atlas *atlas)
+{
+	struct Image *img;
+	
+	assert(game);
+	assert(atlas);
+	assert(!atlas->tex);
+	
+	AtlasPack(atlas);
+	
+	/* unused space is transparent */
+	if (!(atlas->pix = calloc(atlas->w * atlas->h, sizeof(*atlas->pix)))
+		|| !(atlas->span = malloc(atlas->w * atlas->h * sizeof(*atlas->span)))
+	)
+		FlappyFatal("memory error");
+	
+	/* copy each image into place; per-image pixels are no longer needed */
+	for (img = atlas->imageList; img; img = img->next)
+	{
+		int y;
+		
+		for (y = 0; y < img->rect.h; ++y)
+		{
+			int ofs = (img->rect.y + y) * atlas->w + img->rect.x;
+			
+			memcpy(atlas->pix + ofs, img->pix + y * img->rect.w, img->rect.w * sizeof(*img->pix));
+		}
+		
+		free(img->pix);
+		img->pix = 0;
+	}
+	
+	/* spans cover the padding too, so every run has a length */
+	SpanTableBuild(atlas->span, atlas->pix, atlas->w, atlas->h);
+	
+	atlas->tex = TextureFromPixels(game, atlas->pix, atlas->w, atlas->h);
+}
+
+/* deallocate an atlas and every image in it */
+void AtlasFree(struct Flappy *game, struct Atlas *atlas)
+{
+	struct Image *img;
+	struct Image *next = 0;
+	
+	assert(game);
+	assert(atlas);
+	
+	for (img = atlas->imageList; img; img = next)
+	{
+		next = img->next;
+		free(img->pix);
+		free(img);
+	}
+	
+	if (atlas->tex)
+		TextureFree(game, atlas->tex);
+	free(atlas->pix);
+	free(atlas->span);
+	free(atlas);
+}
+
+/* returns the texture containing every image */
+SDL_Texture *AtlasGetTexture(struct Atlas *atlas)
+{
+	assert(atlas);
+	assert(atlas->tex);
+	
+	return atlas->tex;
+}
+
+/* returns the atlas's rgba8888 pixels, which stay around after building */
+const uint32_t *AtlasGetPixels(struct Atlas *atlas, int *w, int *h)
+{
+	assert(atlas);
+	assert(atlas->pix);
+	
+	if (w)
+		*w = atlas->w;
+	if (h)
+		*h = atlas->h;
+	
+	return atlas->pix;
+}
+
+/* returns the atlas's span table, laid out like its pixels */
+const uint16_t *AtlasGetSpans(struct Atlas *atlas)
+{
+	assert(atlas);
+	assert(atlas->span);
+	
+	return atlas->span;
+}
+
+/* describe each pixel of rgba8888 image data by the run it starts: its
+ * enum SpanType and how many pixels to the right (including itself, and
+ * never crossing into the next row) share that type; most pixel art is
+ * long runs of SPAN_CLEAR and SPAN_OPAQUE, which are cheap to draw
+ */
+void SpanTableBuild(uint16_t *span, const uint32_t *pix, int w, int h)
+{
+	int x;
+	int y;
+	
+	assert(span);
+	assert(pix);
+	
+	for (y = 0; y < h; ++y)
+	{
+		const uint8_t *row = (const uint8_t*)(pix + y * w);
+		uint16_t *out = span + y * w;
+		
+		for (x = w - 1; x >= 0; --x)
+		{
+			uint8_t a = row[x * 4 + 3];
+			unsigned type = a == 0 ? SPAN_CLEAR : a == 0xff ? SPAN_OPAQUE : SPAN_BLEND;
+			unsigned len = 1;
+			
+			if (x + 1 < w
+				&& SPAN_TYPE(out[x + 1]) == type
+				&& SPAN_LENGTH(out[x + 1]) < SPAN_LENGTH_MAX
+			)
+				len += SPAN_LENGTH(out[x + 1]);
+			
+			out[x] = (type << 14) | len;
+		}
+	}
+}
+
+/* add raw rgba8888 pixel data to the game's atlas as a new image */
+struct Image *ImageFromPixels(struct Flappy *game, const void *pix, int w, int h)
+{
+	struct Atlas *atlas;
+	struct Image *img;
+	
+	assert(game);
+	assert(game->atlas);
+	assert(pix);
+	assert(w > 0);
+	assert(h > 0);
+	
+	atlas = game->atlas;
+	
+	/* images can't be added after the atlas texture exists */
+	assert(!atlas->tex);
+	
+	if (!(img = calloc(1, sizeof(*img)))
+		|| !(img->pix = malloc(w * h * sizeof(*img->pix)))
+	)
+		FlappyFatal("memory error");
+	
+	memcpy(img->pix, pix, w * h * sizeof(*img->pix));
+	img->rect = (SDL_Rect){0, 0, w, h};
+	
+	/* link into list */
+	img->next = atlas->imageList;
+	atlas->imageList = img;
+	
+	return img;
+}
+
+/* add an image to the game's atlas from a loaded image file */
+struct Image *ImageLoadFrom(struct Flappy *game, void *data, size_t sz)
+{
+	struct Image *img;
+	void *pix;
+	int w;
+	int h;
+	int comp;
+	
+	assert(game);
+	assert(data);
+	assert(sz);
+	
+	/* get rgba8888 pixel data from image */
+	pix = stbi_load_from_memory(data, sz, &w, &h, &comp, STBI_rgb_alpha);
+	if (!pix)
+		FlappyFatal("image processing error");
+	
+	img = ImageFromPixels(game, pix, w, h);
+	
+	/* cleanup */
+	free(pix);
+	
+	return img;
+}
+
+/* add an image to the game's atlas from a filename */
+struct Image *ImageLoad(struct Flappy *game, const char *filename)
+{
+	struct Image *img;
+	size_t sz;
+	void *data;
+	
+	assert(game);
+	assert(filename);
+	
+	/* load, process, and free image data */
+	TRACE_BEGIN(game, "load", filename);
+	data = FileLoad(filename, &sz);
+	img = ImageLoadFrom(game, data, sz);
+	FileFree(data);
+	TRACE_END(game, "load", filename);
+	
+	return img;
+}
+
+/* returns the location of an image within the atlas texture */
+SDL_Rect ImageGetRect(struct Image *img)
+{
+	assert(img);
+	
+	return img->rect;
+}
+
+/* returns an image's rgba8888 pixels; only valid until the atlas is built */
+const uint32_t *ImageGetPixels(struct Image *img)
+{
+	assert(img);
+	assert(img->pix);
+	
+	return img->pix;
+}
+
+/* display part of an image onto the screen; `clip` is relative to the image */
+void ImageDraw(struct Flappy *game, struct Image *img, SDL_Rect clip, float x, float y)
+{
+	SDL_Rect dst;
+	
+	assert(game);
+	assert(img);
+	
+	dst.x = ROUNDING(x);
+	dst.y = ROUNDING(y);
+	dst.w = clip.w;
+	dst.h = clip.h;
+	
+	clip.x += img->rect.x;
+	clip.y += img->rect.y;
+	
+	BatchQuad(game, AtlasGetTexture(game->atlas), clip, dst);
+}
@@ -17,24 +17,68 @@ struct Background
 #define STRIDE  2    /* number of images per row */
 #define WIDTH   200  /* width of a background image */
 #define HEIGHT  112  /* height of a background image */
+#define NUM     8    /* number of images in backgrounds.png */
+
+/* build one strip per background containing its floor twice, side by
+ * side, so the scrolling floor can be drawn with a single copy; this
+ * must happen before the atlas is built
+ */
+void BackgroundInit(struct Flappy *game)
+{
+	const uint32_t *pix;
+	uint32_t *strips;
+	unsigned index;
+	int y;
+	
+	assert(game);
+	assert(game->backgrounds);
+	assert(ImageGetRect(game->backgrounds).w == STRIDE * WIDTH);
+	
+	pix = ImageGetPixels(game->backgrounds);
+	
+	if (!(strips = malloc(WIDTH * 2 * FLOOR_H * NUM * sizeof(*strips))))
+		FlappyFatal("memory error");
+	
+	for (index = 0; index < NUM; ++index)
+	{
+		const uint32_t *src = pix
+			+ ((index / STRIDE) * HEIGHT + HEIGHT - FLOOR_H) * STRIDE * WIDTH
+			+ (index % STRIDE) * WIDTH
+		;
+		uint32_t *dst = strips + index * FLOOR_H * WIDTH * 2;
+		
+		for (y = 0; y < FLOOR_H; ++y)
+		{
+			memcpy(dst + y * WIDTH * 2, src + y * STRIDE * WIDTH, WIDTH * sizeof(*dst));
+			memcpy(dst + y * WIDTH * 2 + WIDTH, src + y * STRIDE * WIDTH, WIDTH * sizeof(*dst));
+		}
+	}
+	
+	game->floors = ImageFromPixels(game, strips, WIDTH * 2, FLOOR_H * NUM);
+	
+	free(strips);
+}
 
 void BackgroundDrawFloor(struct Flappy *game)
 {
 	SDL_Rect clip;
+	unsigned index;
 	float scroll;
 	
 	assert(game);
+	assert(game->floors);
 	
-	clip = game->bgClip;
+	/* which background is being displayed */
+	index = (game->bgClip.y / HEIGHT) * STRIDE + game->bgClip.x / WIDTH;
 	
-	clip.y += clip.h;
-	clip.h = FLOOR_H;
-	clip.y -= clip.h;
-	scroll = WORLD_SCROLL(game->ticks);
+	/* the visible window slides across the doubled strip */
+	scroll = WORLD_SCROLL(FlappyGetDrawTicks(game, 0));
 	scroll = fmodf(scroll, WIDTH);
-	scroll = -scroll;
-	TextureDraw(game, game->backgrounds, clip, scroll, HEIGHT - clip.h);
-	TextureDraw(game, game->backgrounds, clip, scroll + WIDTH, HEIGHT - clip.h);
+	clip.x = ROUNDING(scroll);
+	clip.y = index * FLOOR_H;
+	clip.w = WIDTH;
+	clip.h = FLOOR_H;
+	ImageDraw(game, game->floors, clip, 0, HEIGHT - clip.h);
 }
 
 void BackgroundDraw(struct Flappy *game)
@@ -79,7 +123,7 @@ void BackgroundDraw(struct Flappy *game)
 	index = bg->index;
 	
 	/* for animated backgrounds, use alternate frame when needed */
-	if (bg->time && (game->ticks % (bg->time * 2)) >= bg->time)
+	if (bg->time && (FlappyGetDrawTicks(game, 0) % (bg->time * 2)) >= bg->time)
 		index = bg->anim;
 	
 	/* derive clipping rectangle */
@@ -90,7 +134,7 @@ void BackgroundDraw(struct Flappy *game)
 	clip.h = HEIGHT;
 	
 	/* display background onto screen */
-	TextureDraw(game, game->backgrounds, clip, 0, 0);
+	ImageDraw(game, game->backgrounds, clip, 0, 0);
 	
 	game->bgClip = clip;
 }
@@ -0,0 +1,669 @@
+/*
+ * batch.c <z64.me>
+ *
+ * sprite batching: every quad drawn during a frame is
+ * recorded into one vertex buffer, then submitted with
+ * as few SDL_RenderGeometry calls as possible
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define BATCH_FRAMES  3   /* frames in flight when rendering on its own thread */
+#define BATCH_WAIT_MS 10  /* longest a wait goes before rechecking */
+#define BATCH_HASH_BASIS 2166136261u /* fnv-1a */
+#define BATCH_HASH_PRIME 16777619u
+
+enum BatchCmdType
+{
+	BATCH_CMD_TARGET     /* switch render target */
+	, BATCH_CMD_QUADS    /* draw a run of quads sharing one texture */
+	, BATCH_CMD_INVALIDATE /* renderer state was lost; forget what's cached */
+};
+
+struct BatchCmd
+{
+	enum BatchCmdType   type;
+	SDL_Texture        *tex;       /* render target or quad texture (0 = solid) */
+	int                 quad;      /* first quad in run */
+	int                 quadNum;   /* number of quads in run */
+};
+
+/* everything recorded for one frame; once published it isn't
+ * touched by the game again until the renderer is done with it
+ */
+struct BatchFrame
+{
+	SDL_Vertex         *vert;      /* four vertices per quad */
+	int                 quadNum;
+	int                 quadCap;
+	struct BatchCmd    *cmd;       /* commands recorded this frame */
+	int                 cmdNum;
+	int                 cmdCap;
+	struct BatchStats   stats;     /* statistics for this frame */
+	uint64_t            latency;   /* input first shown by this frame (0 = none) */
+};
+
+struct Batch
+{
+	struct BatchFrame   frame[BATCH_FRAMES];
+	struct BatchFrame  *rec;       /* frame being recorded */
+	int                *index;     /* shared index pattern, six per quad */
+	int                 indexCap;
+	SDL_Color           color;     /* modulation applied to new quads */
+	SDL_Rect            bounds;    /* quads outside this are culled */
+	int                 outputW;   /* window size, as of the last resize */
+	int                 outputH;
+	SDL_Texture        *sizeTex;   /* texture whose size is cached below */
+	int                 sizeW;
+	int                 sizeH;
+	struct BatchStats   statsLast; /* statistics for last presented frame */
+	SDL_SpinLock        statsLock; /* guards statsLast and the totals */
+	unsigned            stateChanges; /* state change totals at last present */
+	unsigned            stateElided;
+	uint32_t            windowHash; /* what the window was last drawn with (0 = unknown) */
+	
+	/* render thread; frames are handed over through a single
+	 * producer, single consumer ring indexed by `head` and `tail`
+	 */
+	SDL_Thread         *thread;
+	SDL_atomic_t        head;      /* frames published by the game */
+	SDL_atomic_t        tail;      /* frames the renderer has finished */
+	SDL_atomic_t        quit;      /* renderer should exit once drained */
+	SDL_sem            *published; /* posted when a frame is published */
+	SDL_sem            *finished;  /* posted when a frame is finished */
+	double              gameWait;  /* total ms spent waiting on each side */
+	double              renderWait;
+	uint64_t            freq;      /* performance counter frequency */
+};
+
+/* returns milliseconds elapsed since performance counter `start` */
+static double BatchElapsed(struct Batch *batch, uint64_t start)
+{
+	assert(batch);
+	
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000 / batch->freq;
+}
+
+/* returns a new command at the end of the list */
+static struct BatchCmd *BatchPushCmd(struct BatchFrame *frame, enum BatchCmdType type, SDL_Texture *tex)
+{
+	struct BatchCmd *cmd;
+	
+	assert(frame);
+	
+	if (frame->cmdNum == frame->cmdCap)
+	{
+		frame->cmdCap = frame->cmdCap ? frame->cmdCap * 2 : 64;
+		if (!(frame->cmd = realloc(frame->cmd, frame->cmdCap * sizeof(*frame->cmd))))
+			FlappyFatal("memory error");
+	}
+	
+	cmd = &frame->cmd[frame->cmdNum++];
+	cmd->type = type;
+	cmd->tex = tex;
+	cmd->quad = frame->quadNum;
+	cmd->quadNum = 0;
+	
+	return cmd;
+}
+
+/* returns the next four vertices, extending or starting a run for `tex` */
+static SDL_Vertex *BatchPushQuad(struct BatchFrame *frame, SDL_Texture *tex)
+{
+	struct BatchCmd *cmd = 0;
+	
+	assert(frame);
+	
+	if (frame->cmdNum)
+		cmd = &frame->cmd[frame->cmdNum - 1];
+	
+	/* texture changed; start a new run */
+	if (!cmd || cmd->type != BATCH_CMD_QUADS || cmd->tex != tex)
+		cmd = BatchPushCmd(frame, BATCH_CMD_QUADS, tex);
+	
+	if (frame->quadNum == frame->quadCap)
+	{
+		frame->quadCap = frame->quadCap ? frame->quadCap * 2 : 256;
+		if (!(frame->vert = realloc(frame->vert, frame->quadCap * 4 * sizeof(*frame->vert))))
+			FlappyFatal("memory error");
+	}
+	
+	cmd->quadNum += 1;
+	frame->stats.quads += 1;
+	
+	return &frame->vert[4 * frame->quadNum++];
+}
+
+/* make sure the index pattern covers at least `quadNum` quads */
+static void BatchGrowIndex(struct Batch *batch, int quadNum)
+{
+	int i;
+	
+	assert(batch);
+	
+	if (quadNum * 6 <= batch->indexCap)
+		return;
+	
+	batch->indexCap = quadNum * 6;
+	if (!(batch->index = realloc(batch->index, batch->indexCap * sizeof(*batch->index))))
+		FlappyFatal("memory error");
+	
+	for (i = 0; i < quadNum; ++i)
+	{
+		int *n = &batch->index[i * 6];
+		
+		n[0] = i * 4 + 0;
+		n[1] = i * 4 + 1;
+		n[2] = i * 4 + 2;
+		n[3] = i * 4 + 0;
+		n[4] = i * 4 + 2;
+		n[5] = i * 4 + 3;
+	}
+}
+
+/* fill in the corners of a quad */
+static void BatchSetQuad(SDL_Vertex *v, SDL_Rect dst, SDL_Color color)
+{
+	v[0].position = (SDL_FPoint){dst.x, dst.y};
+	v[1].position = (SDL_FPoint){dst.x + dst.w, dst.y};
+	v[2].position = (SDL_FPoint){dst.x + dst.w, dst.y + dst.h};
+	v[3].position = (SDL_FPoint){dst.x, dst.y + dst.h};
+	v[0].color = v[1].color = v[2].color = v[3].color = color;
+}
+
+/* returns non-zero if `dst` can't possibly be seen */
+static int BatchCull(struct Batch *batch, SDL_Rect dst)
+{
+	assert(batch);
+	
+	if (dst.x >= batch->bounds.x + batch->bounds.w
+		|| dst.y >= batch->bounds.y + batch->bounds.h
+		|| dst.x + dst.w <= batch->bounds.x
+		|| dst.y + dst.h <= batch->bounds.y
+		|| dst.w <= 0
+		|| dst.h <= 0
+	)
+	{
+		batch->rec->stats.culled += 1;
+		return 1;
+	}
+	
+	return 0;
+}
+
+/* hash everything a frame draws to the window; returns 0 if
+ * the frame invalidates the renderer, since it can't be skipped
+ */
+static uint32_t BatchHashWindow(struct BatchFrame *frame)
+{
+	struct BatchCmd *cmd;
+	SDL_Texture *target = 0;
+	uint32_t hash = BATCH_HASH_BASIS;
+	
+	assert(frame);
+	
+	for (cmd = frame->cmd; cmd < frame->cmd + frame->cmdNum; ++cmd)
+	{
+		const uint8_t *b;
+		const uint8_t *end;
+		
+		if (cmd->type == BATCH_CMD_INVALIDATE)
+			return 0;
+		if (cmd->type == BATCH_CMD_TARGET)
+			target = cmd->tex;
+		if (cmd->type != BATCH_CMD_QUADS || target)
+			continue;
+		
+		for (b = (void*)&cmd->tex, end = b + sizeof(cmd->tex); b < end; ++b)
+			hash = (hash ^ *b) * BATCH_HASH_PRIME;
+		b = (void*)(frame->vert + cmd->quad * 4);
+		for (end = b + cmd->quadNum * 4 * sizeof(*frame->vert); b < end; ++b)
+			hash = (hash ^ *b) * BATCH_HASH_PRIME;
+	}
+	
+	return hash ? hash : 1;
+}
+
+/* execute a recorded frame and display it */
+static void BatchSubmit(struct Flappy *game, struct BatchFrame *frame)
+{
+	struct Batch *batch;
+	struct BatchCmd *cmd;
+	SDL_Texture *target = 0;
+	uint32_t windowHash = 0;
+	unsigned changes;
+	unsigned elided;
+	int idle = 0;
+	
+	assert(game);
+	assert(game->batch);
+	assert(frame);
+	
+	batch = game->batch;
+	
+	BatchGrowIndex(batch, frame->quadNum);
+	
+	/* with the software rasterizer, a frame with no dirty tiles that
+	 * draws the same thing over it (upscale, cursor, overlay) leaves
+	 * the window as it is; this only happens when the pacer rather
+	 * than vsync is pacing, so the game can't spin without a present
+	 */
+	if (game->software && !frame->latency && PacerGetRate(game->pacer))
+		windowHash = BatchHashWindow(frame);
+	
+	for (cmd = frame->cmd; cmd < frame->cmd + frame->cmdNum; ++cmd)
+	{
+		switch (cmd->type)
+		{
+			case BATCH_CMD_TARGET:
+				/* finished drawing into the software framebuffer */
+				if (game->software && target == game->frame)
+				{
+					int dirtyNum;
+					
+					SoftwareUpload(game, game->frame);
+					SoftwareGetDirty(game, &dirtyNum);
+					idle = windowHash && windowHash == batch->windowHash && !dirtyNum;
+				}
+				target = cmd->tex;
+				if (!game->software || target != game->frame)
+					RenderStateSetTarget(game, target);
+				break;
+			
+			case BATCH_CMD_QUADS:
+				if (game->software && target == game->frame)
+				{
+					SoftwareQuads(game, cmd->tex, frame->vert + cmd->quad * 4, cmd->quadNum);
+					break;
+				}
+				
+				/* the window already shows this */
+				if (idle && !target)
+					break;
+				
+				/* modulation lives in the vertex colors, so texture
+				 * mods stay neutral; solid quads blend like textures
+				 */
+				if (cmd->tex)
+				{
+					RenderStateSetTextureColorMod(game, cmd->tex, 0xff, 0xff, 0xff);
+					RenderStateSetTextureAlphaMod(game, cmd->tex, 0xff);
+				}
+				else
+					RenderStateSetDrawBlendMode(game, SDL_BLENDMODE_BLEND);
+				SDL_RenderGeometry(
+					game->renderer
+					, cmd->tex
+					, frame->vert + cmd->quad * 4
+					, cmd->quadNum * 4
+					, batch->index
+					, cmd->quadNum * 6
+				);
+				frame->stats.drawCalls += 1;
+				break;
+			
+			case BATCH_CMD_INVALIDATE:
+				RenderStateInvalidate(game);
+				if (game->software)
+					SoftwareInvalidate(game);
+				if (!game->software || target != game->frame)
+					RenderStateSetTarget(game, target);
+				break;
+		}
+	}
+	
+	if (game->software && target == game->frame)
+		SoftwareUpload(game, game->frame);
+	
+	if (game->capture)
+		CaptureFrame(game);
+	
+	if (!idle)
+		SDL_RenderPresent(game->renderer);
+	batch->windowHash = windowHash;
+	
+	if (frame->latency)
+		LatencyPresented(game, frame->latency);
+	
+	/* state changes made this frame */
+	RenderStateGetCounts(game, &changes, &elided);
+	frame->stats.stateChanges = changes - batch->stateChanges;
+	frame->stats.stateElided = elided - batch->stateElided;
+	batch->stateChanges = changes;
+	batch->stateElided = elided;
+	
+	SDL_AtomicLock(&batch->statsLock);
+	batch->statsLast = frame->stats;
+	batch->gameWait += frame->stats.gameWait;
+	batch->renderWait += frame->stats.renderWait;
+	SDL_AtomicUnlock(&batch->statsLock);
+	
+	/* ready to be recorded into again */
+	memset(&frame->stats, 0, sizeof(frame->stats));
+	frame->quadNum = 0;
+	frame->cmdNum = 0;
+	frame->latency = 0;
+}
+
+/* render thread: draws frames in the order they were published */
+static int BatchThread(void *udata)
+{
+	struct Flappy *game = udata;
+	struct Batch *batch;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	
+	while (1)
+	{
+		uint64_t start = SDL_GetPerformanceCounter();
+		struct BatchFrame *frame;
+		int tail = SDL_AtomicGet(&batch->tail);
+		
+		/* nothing to draw yet; only exit once all frames are drawn */
+		while (SDL_AtomicGet(&batch->head) == tail)
+		{
+			if (SDL_AtomicGet(&batch->quit))
+				return 0;
+			SDL_SemWaitTimeout(batch->published, BATCH_WAIT_MS);
+		}
+		
+		/* the frame was recorded before it was published */
+		SDL_MemoryBarrierAcquire();
+		frame = &batch->frame[tail % BATCH_FRAMES];
+		frame->stats.renderWait = BatchElapsed(batch, start);
+		BatchSubmit(game, frame);
+		
+		/* hand the frame back to the game */
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&batch->tail, tail + 1);
+		SDL_SemPost(batch->finished);
+	}
+	
+	return 0;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate a sprite batch */
+struct Batch *BatchNew(struct Flappy *game)
+{
+	struct Batch *batch = calloc(1, sizeof(*batch));
+	
+	assert(game);
+	
+	if (!batch)
+		return 0;
+	
+	batch->rec = &batch->frame[0];
+	batch->color = (SDL_Color){0xff, 0xff, 0xff, 0xff};
+	batch->bounds = (SDL_Rect){0, 0, WINDOW_W, WINDOW_H};
+	batch->freq = SDL_GetPerformanceFrequency();
+	SDL_GetRendererOutputSize(game->renderer, &batch->outputW, &batch->outputH);
+	
+	return batch;
+}
+
+/* deallocate a sprite batch */
+void BatchFree(struct Batch *batch)
+{
+	int i;
+	
+	assert(batch);
+	assert(!batch->thread);
+	
+	for (i = 0; i < BATCH_FRAMES; ++i)
+	{
+		free(batch->frame[i].vert);
+		free(batch->frame[i].cmd);
+	}
+	free(batch->index);
+	free(batch);
+}
+
+/* present frames from a dedicated render thread; BatchPresent then
+ * only hands each finished recording over, so the game can start on
+ * the next frame while the last one is still being drawn
+ *
+ * SDL doesn't support rendering from a thread other than the one that
+ * created the renderer; its software renderer tolerates it, since it
+ * only draws into memory and copies that to the window, so this is
+ * only allowed with the software renderer
+ */
+void BatchStartThread(struct Flappy *game)
+{
+	struct Batch *batch;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	
+	if (batch->thread)
+		return;
+	
+	if (!game->software)
+	{
+		fprintf(stderr, "render thread needs the software renderer (--software); drawing on the main thread\n");
+		return;
+	}
+	
+	if (!(batch->published = SDL_CreateSemaphore(0))
+		|| !(batch->finished = SDL_CreateSemaphore(0))
+	)
+		SDL_ERR("SDL_CreateSemaphore");
+	
+	SDL_AtomicSet(&batch->quit, 0);
+	if (!(batch->thread = SDL_CreateThread(BatchThread, "render", game)))
+		SDL_ERR("SDL_CreateThread");
+}
+
+/* draw any frames still in flight, then stop the render thread;
+ * returns nonzero if it was running
+ */
+int BatchStopThread(struct Flappy *game)
+{
+	struct Batch *batch;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	
+	if (!batch->thread)
+		return 0;
+	
+	SDL_AtomicSet(&batch->quit, 1);
+	SDL_SemPost(batch->published);
+	SDL_WaitThread(batch->thread, 0);
+	SDL_DestroySemaphore(batch->published);
+	SDL_DestroySemaphore(batch->finished);
+	batch->thread = 0;
+	batch->published = 0;
+	batch->finished = 0;
+	
+	if (game->debug)
+		fprintf(stderr, "render thread: game waited %.1fms, renderer waited %.1fms\n"
+			, batch->gameWait, batch->renderWait
+		);
+	
+	return 1;
+}
+
+/* the window was resized; this is cached so the game never
+ * has to ask the renderer while the render thread owns it
+ */
+void BatchSetOutputSize(struct Flappy *game, int w, int h)
+{
+	assert(game);
+	assert(game->batch);
+	
+	game->batch->outputW = w;
+	game->batch->outputH = h;
+}
+
+/* subsequent drawing goes to `target` (0 = the window) */
+void BatchSetTarget(struct Flappy *game, SDL_Texture *target)
+{
+	struct Batch *batch;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	
+	BatchPushCmd(batch->rec, BATCH_CMD_TARGET, target);
+	
+	/* cull against the new target's dimensions */
+	batch->bounds = (SDL_Rect){0, 0, 0, 0};
+	if (target)
+		SDL_QueryTexture(target, 0, 0, &batch->bounds.w, &batch->bounds.h);
+	else
+	{
+		batch->bounds.w = batch->outputW;
+		batch->bounds.h = batch->outputH;
+	}
+}
+
+/* set the color that subsequent quads are modulated by (or filled with, if solid) */
+void BatchSetColor(struct Flappy *game, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	assert(game);
+	assert(game->batch);
+	
+	game->batch->color = (SDL_Color){r, g, b, a};
+}
+
+/* get the color that subsequent quads are modulated by */
+SDL_Color BatchGetColor(struct Flappy *game)
+{
+	assert(game);
+	assert(game->batch);
+	
+	return game->batch->color;
+}
+
+/* add a textured quad, copying `clip` from `tex` to `dst` */
+void BatchQuad(struct Flappy *game, SDL_Texture *tex, SDL_Rect clip, SDL_Rect dst)
+{
+	struct Batch *batch;
+	SDL_Vertex *v;
+	float u0, v0, u1, v1;
+	
+	assert(game);
+	assert(game->batch);
+	assert(tex);
+	
+	batch = game->batch;
+	
+	if (BatchCull(batch, dst))
+		return;
+	
+	/* texture coordinates are normalized */
+	if (tex != batch->sizeTex)
+	{
+		batch->sizeTex = tex;
+		SDL_QueryTexture(tex, 0, 0, &batch->sizeW, &batch->sizeH);
+	}
+	u0 = (float)clip.x / batch->sizeW;
+	v0 = (float)clip.y / batch->sizeH;
+	u1 = (float)(clip.x + clip.w) / batch->sizeW;
+	v1 = (float)(clip.y + clip.h) / batch->sizeH;
+	
+	v = BatchPushQuad(batch->rec, tex);
+	BatchSetQuad(v, dst, batch->color);
+	v[0].tex_coord = (SDL_FPoint){u0, v0};
+	v[1].tex_coord = (SDL_FPoint){u1, v0};
+	v[2].tex_coord = (SDL_FPoint){u1, v1};
+	v[3].tex_coord = (SDL_FPoint){u0, v1};
+}
+
+/* add a solid rectangle, filled with the current color */
+void BatchRect(struct Flappy *game, SDL_Rect rect)
+{
+	struct Batch *batch;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	
+	if (BatchCull(batch, rect))
+		return;
+	
+	BatchSetQuad(BatchPushQuad(batch->rec, 0), rect, batch->color);
+}
+
+/* renderer state was lost; cached state is forgotten once
+ * everything recorded before now has been drawn
+ */
+void BatchInvalidate(struct Flappy *game)
+{
+	assert(game);
+	assert(game->batch);
+	
+	BatchPushCmd(game->batch->rec, BATCH_CMD_INVALIDATE, 0);
+}
+
+/* submit everything recorded this frame and display it */
+void BatchPresent(struct Flappy *game)
+{
+	struct Batch *batch;
+	uint64_t start;
+	int head;
+	
+	assert(game);
+	assert(game->batch);
+	
+	batch = game->batch;
+	batch->rec->latency = LatencyTakeApplied(game);
+	
+	if (!batch->thread)
+	{
+		BatchSubmit(game, batch->rec);
+		return;
+	}
+	
+	/* publish the frame */
+	head = SDL_AtomicGet(&batch->head) + 1;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&batch->head, head);
+	SDL_SemPost(batch->published);
+	
+	/* wait for the renderer to finish with the next slot */
+	start = SDL_GetPerformanceCounter();
+	while (head - SDL_AtomicGet(&batch->tail) >= BATCH_FRAMES)
+		SDL_SemWaitTimeout(batch->finished, BATCH_WAIT_MS);
+	SDL_MemoryBarrierAcquire();
+	batch->rec = &batch->frame[head % BATCH_FRAMES];
+	batch->rec->stats.gameWait = BatchElapsed(batch, start);
+}
+
+/* get statistics about the last frame that was presented */
+struct BatchStats BatchGetStats(struct Flappy *game)
+{
+	struct BatchStats stats;
+	
+	assert(game);
+	assert(game->batch);
+	
+	SDL_AtomicLock(&game->batch->statsLock);
+	stats = game->batch->statsLast;
+	SDL_AtomicUnlock(&game->batch->statsLock);
+	
+	return stats;
+}
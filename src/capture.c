@@ -0,0 +1,609 @@
+/*
+ * capture.c <z64.me>
+ *
+ * frame capture: each presented frame is copied out of the
+ * native resolution target into a pooled buffer, then saved
+ * by worker threads as a png/qoi sequence or a y4m stream;
+ * if the workers fall behind, frames are dropped, not waited on
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define CAPTURE_BUFFERS  8   /* frames that can be waiting to be saved */
+#define CAPTURE_WORKERS  2   /* threads saving image sequences */
+#define CAPTURE_RATE     60  /* y4m frame rate if the pacer's is unknown */
+
+enum CaptureFormat
+{
+	CAPTURE_FORMAT_PNG
+	, CAPTURE_FORMAT_QOI
+	, CAPTURE_FORMAT_Y4M
+};
+
+struct CaptureBuffer
+{
+	uint32_t              *pix;    /* argb8888 pixels */
+	unsigned               frame;  /* frame number */
+	struct CaptureBuffer  *next;   /* next in free list or queue */
+};
+
+struct Capture
+{
+	const char            *dir;       /* where image sequences are saved */
+	enum CaptureFormat     format;
+	FILE                  *stream;    /* y4m output */
+	struct CaptureBuffer   buf[CAPTURE_BUFFERS];
+	struct CaptureBuffer  *free;      /* buffers not in use */
+	struct CaptureBuffer  *queue;     /* buffers waiting to be saved, oldest first */
+	struct CaptureBuffer **queueEnd;
+	SDL_mutex             *lock;      /* guards everything below */
+	SDL_cond              *ready;     /* signaled when queued or quitting */
+	SDL_Thread            *worker[CAPTURE_WORKERS];
+	int                    workerNum;
+	int                    quit;
+	unsigned               frames;    /* frames offered for capture */
+	unsigned               saved;
+	unsigned               dropped;   /* no buffer was free */
+	unsigned               failed;    /* couldn't be read or written */
+};
+
+/* growable output for the encoders, one per worker */
+struct CaptureOut
+{
+	uint8_t               *data;
+	size_t                 num;
+	size_t                 cap;
+};
+
+/* append `sz` bytes to `out`, returning where they go */
+static uint8_t *CaptureOutGrow(struct CaptureOut *out, size_t sz)
+{
+	uint8_t *p;
+	
+	assert(out);
+	
+	if (out->num + sz > out->cap)
+	{
+		out->cap = (out->num + sz) * 2;
+		if (!(out->data = realloc(out->data, out->cap)))
+			FlappyFatal("memory error");
+	}
+	
+	p = out->data + out->num;
+	out->num += sz;
+	
+	return p;
+}
+
+static void CaptureOutByte(struct CaptureOut *out, uint8_t v)
+{
+	*CaptureOutGrow(out, 1) = v;
+}
+
+static void CaptureOutU32BE(struct CaptureOut *out, uint32_t v)
+{
+	uint8_t *p = CaptureOutGrow(out, 4);
+	
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* qoi, per the specification at qoiformat.org */
+static void CaptureEncodeQoi(struct CaptureOut *out, const uint32_t *pix, int w, int h)
+{
+	uint32_t seen[64] = {0};
+	uint32_t prev = 0xff000000;
+	int run = 0;
+	int i;
+	
+	memcpy(CaptureOutGrow(out, 4), "qoif", 4);
+	CaptureOutU32BE(out, w);
+	CaptureOutU32BE(out, h);
+	CaptureOutByte(out, 3); /* rgb */
+	CaptureOutByte(out, 0); /* srgb */
+	
+	for (i = 0; i < w * h; ++i)
+	{
+		uint32_t c = pix[i] | 0xff000000; /* frames are opaque */
+		int r = (c >> 16) & 0xff;
+		int g = (c >> 8) & 0xff;
+		int b = c & 0xff;
+		int a = c >> 24;
+		int hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+		
+		if (c == prev)
+		{
+			if (++run == 62 || i == w * h - 1)
+			{
+				CaptureOutByte(out, 0xc0 | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		
+		if (run)
+		{
+			CaptureOutByte(out, 0xc0 | (run - 1));
+			run = 0;
+		}
+		
+		if (seen[hash] == c)
+			CaptureOutByte(out, hash);
+		else if ((c >> 24) == (prev >> 24))
+		{
+			int dr = (int8_t)(r - ((prev >> 16) & 0xff));
+			int dg = (int8_t)(g - ((prev >> 8) & 0xff));
+			int db = (int8_t)(b - (prev & 0xff));
+			
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+				CaptureOutByte(out, 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+			else if (dg >= -32 && dg <= 31
+				&& dr - dg >= -8 && dr - dg <= 7
+				&& db - dg >= -8 && db - dg <= 7
+			)
+			{
+				CaptureOutByte(out, 0x80 | (dg + 32));
+				CaptureOutByte(out, (dr - dg + 8) << 4 | (db - dg + 8));
+			}
+			else
+			{
+				CaptureOutByte(out, 0xfe);
+				CaptureOutByte(out, r);
+				CaptureOutByte(out, g);
+				CaptureOutByte(out, b);
+			}
+		}
+		else
+		{
+			CaptureOutByte(out, 0xff);
+			CaptureOutByte(out, r);
+			CaptureOutByte(out, g);
+			CaptureOutByte(out, b);
+			CaptureOutByte(out, a);
+		}
+		
+		seen[hash] = c;
+		prev = c;
+	}
+	
+	memcpy(CaptureOutGrow(out, 8), "\0\0\0\0\0\0\0\1", 8);
+}
+
+/* crc-32 as used by png */
+static uint32_t CaptureCrc(const uint8_t *data, size_t sz)
+{
+	static uint32_t table[256];
+	static SDL_SpinLock tableLock;
+	static int tableValid;
+	uint32_t crc = 0xffffffff;
+	size_t i;
+	
+	SDL_AtomicLock(&tableLock);
+	if (!tableValid)
+	{
+		for (i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			int k;
+			
+			for (k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		tableValid = 1;
+	}
+	SDL_AtomicUnlock(&tableLock);
+	
+	for (i = 0; i < sz; ++i)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	
+	return crc ^ 0xffffffff;
+}
+
+/* finish a png chunk whose type begins at `start` */
+static void CaptureEndChunk(struct CaptureOut *out, size_t start)
+{
+	uint8_t *p = out->data + start - 4;
+	uint32_t len = out->num - start - 4;
+	
+	p[0] = len >> 24;
+	p[1] = len >> 16;
+	p[2] = len >> 8;
+	p[3] = len;
+	CaptureOutU32BE(out, CaptureCrc(out->data + start, out->num - start));
+}
+
+/* start a png chunk, returning where its type begins */
+static size_t CaptureStartChunk(struct CaptureOut *out, const char *type)
+{
+	CaptureOutU32BE(out, 0); /* length, filled in later */
+	memcpy(CaptureOutGrow(out, 4), type, 4);
+	
+	return out->num - 4;
+}
+
+/* png, rgb with the image data in uncompressed deflate blocks;
+ * big files, but saving them costs next to nothing
+ */
+static void CaptureEncodePng(struct CaptureOut *out, const uint32_t *pix, int w, int h)
+{
+	size_t rowSz = 1 + w * 3;
+	size_t rawSz = rowSz * h;
+	size_t done = 0;
+	uint32_t a = 1;
+	uint32_t b = 0;
+	size_t chunk;
+	int x;
+	int y;
+	
+	memcpy(CaptureOutGrow(out, 8), "\x89PNG\r\n\x1a\n", 8);
+	
+	chunk = CaptureStartChunk(out, "IHDR");
+	CaptureOutU32BE(out, w);
+	CaptureOutU32BE(out, h);
+	CaptureOutByte(out, 8); /* bit depth */
+	CaptureOutByte(out, 2); /* rgb */
+	CaptureOutByte(out, 0); /* compression, filter, interlace */
+	CaptureOutByte(out, 0);
+	CaptureOutByte(out, 0);
+	CaptureEndChunk(out, chunk);
+	
+	chunk = CaptureStartChunk(out, "IDAT");
+	CaptureOutByte(out, 0x78); /* zlib header */
+	CaptureOutByte(out, 0x01);
+	for (y = 0; y < h; ++y)
+	{
+		const uint32_t *row = pix + y * w;
+		
+		for (x = -1; x < w; ++x)
+		{
+			uint8_t v[3] = {0};
+			int n = 1;
+			int i;
+			
+			/* each row starts with its filter type (none) */
+			if (x >= 0)
+			{
+				v[0] = row[x] >> 16;
+				v[1] = row[x] >> 8;
+				v[2] = row[x];
+				n = 3;
+			}
+			
+			for (i = 0; i < n; ++i)
+			{
+				/* new stored block every 64k */
+				if (!(done % 0xffff))
+				{
+					size_t left = SDL_min(rawSz - done, 0xffff);
+					
+					CaptureOutByte(out, done + left == rawSz);
+					CaptureOutByte(out, left);
+					CaptureOutByte(out, left >> 8);
+					CaptureOutByte(out, ~left);
+					CaptureOutByte(out, ~left >> 8);
+				}
+				CaptureOutByte(out, v[i]);
+				a = (a + v[i]) % 65521;
+				b = (b + a) % 65521;
+				done += 1;
+			}
+		}
+	}
+	CaptureOutU32BE(out, b << 16 | a);
+	CaptureEndChunk(out, chunk);
+	
+	chunk = CaptureStartChunk(out, "IEND");
+	CaptureEndChunk(out, chunk);
+}
+
+/* y4m frame, 4:2:0 with full range bt.601 (jpeg) coefficients */
+static void CaptureEncodeY4m(struct CaptureOut *out, const uint32_t *pix, int w, int h)
+{
+	uint8_t *lum;
+	uint8_t *cb;
+	uint8_t *cr;
+	int cw = (w + 1) / 2;
+	int ch = (h + 1) / 2;
+	int x;
+	int y;
+	
+	memcpy(CaptureOutGrow(out, 6), "FRAME\n", 6);
+	lum = CaptureOutGrow(out, w * h + cw * ch * 2);
+	cb = lum + w * h;
+	cr = cb + cw * ch;
+	
+	for (y = 0; y < h; ++y)
+	{
+		for (x = 0; x < w; ++x)
+		{
+			uint32_t c = pix[y * w + x];
+			int r = (c >> 16) & 0xff;
+			int g = (c >> 8) & 0xff;
+			int b = c & 0xff;
+			
+			lum[y * w + x] = (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+		}
+	}
+	
+	for (y = 0; y < ch; ++y)
+	{
+		for (x = 0; x < cw; ++x)
+		{
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			int n = 0;
+			int i;
+			
+			/* average each 2x2 block */
+			for (i = 0; i < 4; ++i)
+			{
+				int px = x * 2 + (i & 1);
+				int py = y * 2 + (i >> 1);
+				uint32_t c;
+				
+				if (px >= w || py >= h)
+					continue;
+				c = pix[py * w + px];
+				r += (c >> 16) & 0xff;
+				g += (c >> 8) & 0xff;
+				b += c & 0xff;
+				n += 1;
+			}
+			r /= n;
+			g /= n;
+			b /= n;
+			
+			cb[y * cw + x] = (-11059 * r - 21709 * g + 32768 * b + 8421376) >> 16;
+			cr[y * cw + x] = (32768 * r - 27439 * g - 5329 * b + 8421376) >> 16;
+		}
+	}
+}
+
+/* encode and save one frame; returns non-zero on failure */
+static int CaptureSave(struct Capture *capture, struct CaptureOut *out, struct CaptureBuffer *buf)
+{
+	char fn[1024];
+	FILE *fp;
+	int rval;
+	
+	assert(capture);
+	assert(out);
+	assert(buf);
+	
+	out->num = 0;
+	
+	if (capture->format == CAPTURE_FORMAT_Y4M)
+	{
+		CaptureEncodeY4m(out, buf->pix, WINDOW_W, WINDOW_H);
+		return fwrite(out->data, 1, out->num, capture->stream) != out->num;
+	}
+	
+	if (capture->format == CAPTURE_FORMAT_QOI)
+		CaptureEncodeQoi(out, buf->pix, WINDOW_W, WINDOW_H);
+	else
+		CaptureEncodePng(out, buf->pix, WINDOW_W, WINDOW_H);
+	
+	snprintf(fn, sizeof(fn), "%s/frame%06u.%s"
+		, capture->dir
+		, buf->frame
+		, capture->format == CAPTURE_FORMAT_QOI ? "qoi" : "png"
+	);
+	if (!(fp = fopen(fn, "wb")))
+		return -1;
+	rval = fwrite(out->data, 1, out->num, fp) != out->num;
+	if (fclose(fp))
+		rval = -1;
+	
+	return rval;
+}
+
+/* worker thread: saves queued frames until told to quit, then
+ * saves whatever is left
+ */
+static int CaptureWorker(void *udata)
+{
+	struct Capture *capture = udata;
+	struct CaptureOut out = {0};
+	
+	assert(capture);
+	
+	SDL_LockMutex(capture->lock);
+	while (1)
+	{
+		struct CaptureBuffer *buf;
+		int failed;
+		
+		if (!(buf = capture->queue))
+		{
+			if (capture->quit)
+				break;
+			SDL_CondWait(capture->ready, capture->lock);
+			continue;
+		}
+		if (!(capture->queue = buf->next))
+			capture->queueEnd = &capture->queue;
+		SDL_UnlockMutex(capture->lock);
+		
+		failed = CaptureSave(capture, &out, buf);
+		
+		SDL_LockMutex(capture->lock);
+		if (failed)
+			capture->failed += 1;
+		else
+			capture->saved += 1;
+		buf->next = capture->free;
+		capture->free = buf;
+	}
+	SDL_UnlockMutex(capture->lock);
+	
+	free(out.data);
+	
+	return 0;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* start capturing frames in `format` ("png", "qoi", or "y4m"); image
+ * sequences are saved into the existing directory `path`, while y4m
+ * streams are written to the file `path`
+ */
+struct Capture *CaptureNew(struct Flappy *game, const char *path, const char *format)
+{
+	struct Capture *capture = calloc(1, sizeof(*capture));
+	int i;
+	
+	assert(game);
+	assert(path);
+	assert(format);
+	
+	if (!capture)
+		return 0;
+	
+	if (!strcmp(format, "png"))
+		capture->format = CAPTURE_FORMAT_PNG;
+	else if (!strcmp(format, "qoi"))
+		capture->format = CAPTURE_FORMAT_QOI;
+	else if (!strcmp(format, "y4m"))
+		capture->format = CAPTURE_FORMAT_Y4M;
+	else
+		FlappyFatal("unknown capture format '%s'", format);
+	
+	capture->dir = path;
+	capture->queueEnd = &capture->queue;
+	
+	for (i = 0; i < CAPTURE_BUFFERS; ++i)
+	{
+		struct CaptureBuffer *buf = &capture->buf[i];
+		
+		if (!(buf->pix = malloc(WINDOW_W * WINDOW_H * sizeof(*buf->pix))))
+			FlappyFatal("memory error");
+		buf->next = capture->free;
+		capture->free = buf;
+	}
+	
+	/* a stream's frames must be saved in order, so it gets one worker */
+	if (capture->format == CAPTURE_FORMAT_Y4M)
+	{
+		unsigned rate = PacerGetRate(game->pacer);
+		
+		if (!(capture->stream = fopen(path, "wb")))
+			FlappyFatal("failed to open '%s' for writing", path);
+		fprintf(capture->stream, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n"
+			, WINDOW_W, WINDOW_H, rate ? rate : CAPTURE_RATE
+		);
+		capture->workerNum = 1;
+	}
+	else
+		capture->workerNum = CAPTURE_WORKERS;
+	
+	if (!(capture->lock = SDL_CreateMutex()))
+		SDL_ERR("SDL_CreateMutex");
+	if (!(capture->ready = SDL_CreateCond()))
+		SDL_ERR("SDL_CreateCond");
+	for (i = 0; i < capture->workerNum; ++i)
+		if (!(capture->worker[i] = SDL_CreateThread(CaptureWorker, "capture", capture)))
+			SDL_ERR("SDL_CreateThread");
+	
+	return capture;
+}
+
+/* save every frame still queued, then stop capturing */
+void CaptureFree(struct Capture *capture)
+{
+	int i;
+	
+	assert(capture);
+	
+	SDL_LockMutex(capture->lock);
+	capture->quit = 1;
+	SDL_CondBroadcast(capture->ready);
+	SDL_UnlockMutex(capture->lock);
+	
+	for (i = 0; i < capture->workerNum; ++i)
+		SDL_WaitThread(capture->worker[i], 0);
+	
+	fprintf(stderr, "capture: %u frames saved, %u dropped, %u failed\n"
+		, capture->saved, capture->dropped, capture->failed
+	);
+	
+	if (capture->stream && fclose(capture->stream))
+		fprintf(stderr, "capture: error closing '%s'\n", capture->dir);
+	for (i = 0; i < CAPTURE_BUFFERS; ++i)
+		free(capture->buf[i].pix);
+	SDL_DestroyCond(capture->ready);
+	SDL_DestroyMutex(capture->lock);
+	free(capture);
+}
+
+/* copy the frame just drawn into `game->frame` and queue it to be
+ * saved; if no buffer is free, the frame is dropped; the window is
+ * left as the render target
+ */
+void CaptureFrame(struct Flappy *game)
+{
+	struct Capture *capture;
+	struct CaptureBuffer *buf;
+	
+	assert(game);
+	assert(game->capture);
+	
+	capture = game->capture;
+	
+	SDL_LockMutex(capture->lock);
+	if ((buf = capture->free))
+	{
+		capture->free = buf->next;
+		buf->frame = capture->frames;
+	}
+	else
+		capture->dropped += 1;
+	capture->frames += 1;
+	SDL_UnlockMutex(capture->lock);
+	
+	if (!buf)
+		return;
+	
+	/* the software rasterizer's framebuffer is already in memory */
+	if (game->software)
+		memcpy(buf->pix, SoftwareGetPixels(game), WINDOW_W * WINDOW_H * sizeof(*buf->pix));
+	else
+	{
+		RenderStateSetTarget(game, game->frame);
+		if (SDL_RenderReadPixels(game->renderer, 0
+			, SDL_PIXELFORMAT_ARGB8888, buf->pix, WINDOW_W * sizeof(*buf->pix))
+		)
+		{
+			RenderStateSetTarget(game, 0);
+			SDL_LockMutex(capture->lock);
+			capture->failed += 1;
+			buf->next = capture->free;
+			capture->free = buf;
+			SDL_UnlockMutex(capture->lock);
+			return;
+		}
+		RenderStateSetTarget(game, 0);
+	}
+	
+	SDL_LockMutex(capture->lock);
+	buf->next = 0;
+	*capture->queueEnd = buf;
+	capture->queueEnd = &buf->next;
+	SDL_CondSignal(capture->ready);
+	SDL_UnlockMutex(capture->lock);
+}
@@ -95,13 +95,15 @@ const struct ColliderInit *ColliderInitRect(struct Flappy *game, const float x,
 	
 	collider.type = COLLIDER_TYPE_RECT;
 	collider.shape.rect = (SDL_Rect){
-		ROUNDING(x * game->scale)
-		, ROUNDING(y * game->scale)
-		, ROUNDING(w * game->scale)
-		, ROUNDING(h * game->scale)
+		ROUNDING(x)
+		, ROUNDING(y)
+		, ROUNDING(w)
+		, ROUNDING(h)
 	};
 	
 	return &collider;
+	
+	(void)game;
 }
 
 /* initialize collision arena */
@@ -148,21 +150,37 @@ void ColliderArenaPush(struct Flappy *game, void *instance, ColliderCallback cb,
 	c->init = *init;
 }
 
+/* count colliders in use, and how many have been allocated */
+void ColliderArenaGetCounts(struct Flappy *game, unsigned *live, unsigned *cap)
+{
+	struct Collider *c;
+	
+	assert(game);
+	assert(live);
+	assert(cap);
+	
+	*live = *cap = 0;
+	for (c = game->colliderList; c; c = c->next)
+	{
+		*live += !c->expired;
+		*cap += 1;
+	}
+}
+
 /* draw collider arena's contents */
 void ColliderArenaDraw(struct Flappy *game, uint32_t bgcolor, uint32_t outlinecolor, const int opacity)
 {
 	struct Collider *c;
-	uint8_t r, g, b, a;
-	SDL_Rect full = {0, 0, WINDOW_W * game->scale, WINDOW_H * game->scale};
+	SDL_Color old;
+	SDL_Rect full = {0, 0, WINDOW_W, WINDOW_H};
 	
 	assert(game);
 	
-	SDL_GetRenderDrawColor(game->renderer, &r, &g, &b, &a);
-	SDL_SetRenderDrawBlendMode(game->renderer, SDL_BLENDMODE_BLEND);
+	old = BatchGetColor(game);
 	
 	/* clear background */
-	SDL_SetRenderDrawColor(
-		game->renderer
+	BatchSetColor(
+		game
 		, bgcolor >> 24
 		, bgcolor >> 16
 		, bgcolor >> 8
@@ -175,7 +193,7 @@ void ColliderArenaDraw(struct Flappy *game, uint32_t bgcolor, uint32_t outlineco
 		if (c->expired)
 			continue;
 		
-		SDL_SetRenderDrawColor(game->renderer, c->color >> 16, c->color >> 8, c->color, opacity);
+		BatchSetColor(game, c->color >> 16, c->color >> 8, c->color, opacity);
 		
 		switch (c->init.type)
 		{
@@ -183,8 +201,8 @@ void ColliderArenaDraw(struct Flappy *game, uint32_t bgcolor, uint32_t outlineco
 				PrimitiveRect(game, c->init.shape.rect);
 				if (outlinecolor)
 				{
-					SDL_SetRenderDrawColor(
-						game->renderer
+					BatchSetColor(
+						game
 						, outlinecolor >> 24
 						, outlinecolor >> 16
 						, outlinecolor >> 8
@@ -199,7 +217,7 @@ void ColliderArenaDraw(struct Flappy *game, uint32_t bgcolor, uint32_t outlineco
 		}
 	}
 	
-	SDL_SetRenderDrawColor(game->renderer, r, g, b, a);
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
 }
 
 /* execute collider frame by testing every collider against every other */
@@ -221,6 +239,8 @@ void ColliderArenaProcess(struct Flappy *game)
 			
 			c->touched = touch->touched = 1;
 			
+			TRACE_INSTANT(game, "collision", "collision", 0);
+			
 			if (touch->cb)
 				touch->cb(game, touch->instance);
 			
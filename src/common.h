@@ -44,6 +44,28 @@
 #define COLOR_PLAYER      0x606000
 #define GAMEOVER_TIME     1000 /* milliseconds before showing game over screen */
 #define CLICK_BLINK       500  /* milliseconds before showing 'Click!' prompt */
+#define SIM_STEPS_MAX     16   /* most fixed simulation steps run per frame */
+#define LERP(A, B, T)     ((A) + ((B) - (A)) * (T))
+#define PARABOLA_FIXED_SHIFT 4 /* fractional bits in fixed point trajectories */
+#define SPAN_TYPE(X)      ((X) >> 14) /* enum SpanType of a span table entry */
+#define SPAN_LENGTH(X)    ((X) & 0x3fff) /* pixels left in run, from this one */
+#define SPAN_LENGTH_MAX   0x3fff
+#define HISTOGRAM_BUCKETS 1024 /* buckets in a struct Histogram */
+
+/* profiler zones and trace events, which only exist in FLAPPY_PROFILE builds */
+#ifdef FLAPPY_PROFILE
+	#define PROFILE_BEGIN(GAME, ZONE) ProfileBegin(GAME, ZONE)
+	#define PROFILE_END(GAME, ZONE)   ProfileEnd(GAME, ZONE)
+	#define TRACE_BEGIN(GAME, CAT, NAME) TracePush(GAME, 'B', CAT, NAME, 0)
+	#define TRACE_END(GAME, CAT, NAME)   TracePush(GAME, 'E', CAT, NAME, 0)
+	#define TRACE_INSTANT(GAME, CAT, NAME, VALUE) TracePush(GAME, 'i', CAT, NAME, VALUE)
+#else
+	#define PROFILE_BEGIN(GAME, ZONE) ((void)0)
+	#define PROFILE_END(GAME, ZONE)   ((void)0)
+	#define TRACE_BEGIN(GAME, CAT, NAME) ((void)0)
+	#define TRACE_END(GAME, CAT, NAME)   ((void)0)
+	#define TRACE_INSTANT(GAME, CAT, NAME, VALUE) ((void)0)
+#endif
 
 /******************************
  *
@@ -52,12 +74,25 @@
  ******************************/
 
 struct Player;
+struct Atlas;
+struct Image;
 struct Spritesheet;
 struct Obstacle;
 struct Particle;
 struct Collider;
 struct ColliderInit;
 struct Timer;
+struct Pacer;
+struct Batch;
+struct RenderState;
+struct Software;
+struct Capture;
+struct UiState;
+struct Latency;
+struct InputSource;
+struct Profile;
+struct Trace;
+struct Hud;
 
 
 /******************************
@@ -87,14 +122,6 @@ enum FlappyButton
 	, FLAPPY_BUTTON_MAX
 };
 
-enum FlappyMouse
-{
-	FLAPPY_MOUSE_OFF = 0
-	, FLAPPY_MOUSE_HOVERING   = (1 << 0)
-	, FLAPPY_MOUSE_CLICKING   = (1 << 1)
-	, FLAPPY_MOUSE_CLICKED    = (1 << 3)
-};
-
 enum FlappyState
 {
 	FLAPPY_STATE_TITLE = 0  /* title screen */
@@ -108,7 +135,50 @@ enum FlappyDebug
 	FLAPPY_DEBUG_OFF = 0
 	, FLAPPY_DEBUG_GHOST = (1 << 0)
 	, FLAPPY_DEBUG_COLLISION = (1 << 1)
-	, FLAPPY_DEBUG_ALL = (FLAPPY_DEBUG_GHOST | FLAPPY_DEBUG_COLLISION)
+	, FLAPPY_DEBUG_PERF = (1 << 2)
+	, FLAPPY_DEBUG_ALL = (FLAPPY_DEBUG_GHOST | FLAPPY_DEBUG_COLLISION | FLAPPY_DEBUG_PERF)
+};
+
+/* parts of a frame timed by the performance overlay */
+enum HudPhase
+{
+	HUD_PHASE_SIM
+	, HUD_PHASE_DRAW
+	, HUD_PHASE_MAX
+};
+
+/* phases of a frame timed by the profiler */
+enum ProfileZone
+{
+	PROFILE_FRAME
+	, PROFILE_INPUT
+	, PROFILE_UPDATE_TIMER
+	, PROFILE_UPDATE_COLLIDERS
+	, PROFILE_UPDATE_HAZARDS
+	, PROFILE_UPDATE_OBSTACLES
+	, PROFILE_UPDATE_PLAYER
+	, PROFILE_UPDATE_ARENA
+	, PROFILE_DRAW_WORLD
+	, PROFILE_DRAW_UI
+	, PROFILE_DRAW_PRESENT
+	, PROFILE_WAIT
+	, PROFILE_ZONE_MAX
+};
+
+enum ParabolaFormat
+{
+	PARABOLA_FORMAT_F32       /* float */
+	, PARABOLA_FORMAT_F16     /* uint16_t, IEEE 754 half precision */
+	, PARABOLA_FORMAT_FIXED   /* int16_t, fixed point (PARABOLA_FIXED_SHIFT) */
+	, PARABOLA_FORMAT_MAX
+};
+
+/* classes of pixel runs in span tables */
+enum SpanType
+{
+	SPAN_CLEAR = 0            /* fully transparent; nothing to draw */
+	, SPAN_OPAQUE             /* fully opaque; can be copied */
+	, SPAN_BLEND              /* partially transparent; must be blended */
 };
 
 enum ParticleType
@@ -128,30 +198,86 @@ enum ParticleType
  *
  ******************************/
 
+/* distribution of durations, in milliseconds */
+struct Histogram
+{
+	unsigned            bucket[HISTOGRAM_BUCKETS];
+	unsigned            count;             /* samples added */
+	double              resolution;        /* milliseconds per smallest bucket */
+	double              sum;               /* total of all samples */
+	double              max;               /* largest sample */
+};
+
+/* a score as laid out on screen; only redone when the score changes */
+struct UiScore
+{
+	unsigned            value;             /* score this layout is for */
+	unsigned            valid:1;           /* layout has been done */
+	int                 width;             /* width in pixels */
+	int                 digitNum;
+	uint8_t             digit[4];          /* digits, most significant first */
+	uint8_t             x[4];              /* offset of each digit */
+};
+
+/* quadratic equation parameters */
+struct Parabola
+{
+	float               y;                 /* initial y position */
+	uint32_t            ticks;             /* initial time */
+};
+
+/* rendering statistics for one frame */
+struct BatchStats
+{
+	unsigned            drawCalls;         /* SDL draw calls issued */
+	unsigned            quads;             /* quads submitted */
+	unsigned            culled;            /* quads skipped for being off-screen */
+	unsigned            stateChanges;      /* render state changes sent to SDL */
+	unsigned            stateElided;       /* redundant state changes skipped */
+	float               gameWait;          /* ms the game waited for a free frame */
+	float               renderWait;        /* ms the render thread waited for a frame */
+};
+
 struct Input
 {
 	unsigned  quit:1;       /* user wishes to exit */
 	unsigned  space:1;      /* spacebar */
 	unsigned  mouseDown:1;  /* mouse button press */
 	unsigned  clicked:1;    /* mouse clicked (was pressed and released) */
+	unsigned  pressed:1;    /* mouse pressed since the last simulation step */
 	float     mouseX;       /* most recent cursor coordinates */
 	float     mouseY;
 	float     clickX;       /* cursor coordinates on press */
 	float     clickY;
+	uint32_t  clickStamp;   /* SDL timestamp of press */
 };
 
 struct Flappy
 {
 	SDL_Window         *window;           /* window */
 	SDL_Renderer       *renderer;         /* rendering context */
-	SDL_Texture        *backgrounds;      /* backgrounds.png */
-	SDL_Texture        *obstacles;        /* obstacles.png */
-	SDL_Texture        *particles;        /* particles.png */
-	SDL_Texture        *jabu;             /* jabu.png */
+	SDL_Texture        *frame;            /* native resolution render target */
+	struct Batch       *batch;            /* sprite batch for drawing */
+	struct RenderState *renderState;      /* tracks renderer state */
+	struct Software    *software;         /* software rasterizer (0 = use SDL) */
+	struct Capture     *capture;          /* frame capture (0 = not capturing) */
+	struct Atlas       *atlas;            /* texture atlas containing all images */
+	struct Image       *backgrounds;      /* backgrounds.png */
+	struct Image       *floors;           /* floors from backgrounds.png, doubled */
+	struct Image       *obstacles;        /* obstacles.png */
+	struct Image       *particles;        /* particles.png */
+	struct Image       *jabu;             /* jabu.png */
 	struct Spritesheet *sprites;          /* sprites.png */
 	struct Spritesheet *ui;               /* ui.png */
+	struct UiState     *uiState;          /* retained user interface */
 	struct Player      *player;           /* player game instance */
 	struct Timer       *timer;            /* high resolution game timer */
+	struct Pacer       *pacer;            /* frame rate limiter */
+	struct Latency     *latency;          /* input latency measurement */
+	struct Hud         *hud;              /* performance overlay */
+	struct InputSource *inputSource;      /* scripted input (0 = none) */
+	struct Profile     *profile;          /* frame profiler (0 = not profiling) */
+	struct Trace       *trace;            /* timeline trace (0 = not tracing) */
 	struct Obstacle    *obstacleList;     /* linked list of obstacles */
 	struct Particle    *particleList;     /* linked list of particles */
 	struct Collider    *colliderList;     /* linked list of colliders */
@@ -166,7 +292,8 @@ struct Flappy
 	unsigned            highscoreNew;     /* boolean 'New!' indicator */
 	unsigned            highscore;        /* player's high score */
 	unsigned            score;            /* player's current score */
-	unsigned            buttonhover;      /* boolean tracking UI button hover */
+	struct UiScore      scoreUi;          /* layout of score */
+	struct UiScore      highscoreUi;      /* layout of high score */
 	unsigned            playerflapped;    /* boolean whether player flapped yet */
 	unsigned            jabuHazardActive; /* boolean tracking jabu stage hazard */
 	unsigned            windowMinimized;  /* boolean tracking is window minimized */
@@ -175,6 +302,10 @@ struct Flappy
 	uint32_t            stateStartTime;   /* time of last state change */
 	uint32_t            themeTicks;       /* milliseconds game using current theme */
 	uint32_t            themeStartTime;   /* time of last theme change */
+	unsigned            simRate;          /* fixed simulation steps per second (0 = one step per frame) */
+	double              simTime;          /* milliseconds simulated so far, for fixed steps */
+	float               simAlpha;         /* how far rendering is between the last two steps */
+	uint32_t            drawTicks;        /* game time being drawn, between the last two steps */
 };
 
 typedef void ColliderCallback(struct Flappy *game, void *instance);
@@ -199,9 +330,65 @@ SDL_Surface *SurfaceLoad(struct Flappy *game, const char *filename);
 SDL_Texture *TextureFromPixels(struct Flappy *game, const void *pix, int w, int h);
 SDL_Texture *TextureLoadFrom(struct Flappy *game, void *data, size_t sz);
 SDL_Texture *TextureLoad(struct Flappy *game, const char *filename);
-void TextureDraw(struct Flappy *game, SDL_Texture *tex, SDL_Rect clip, float x, float y);
 void TextureFree(struct Flappy *game, SDL_Texture *tex);
 
+/* texture atlas and the images within it */
+struct Atlas *AtlasNew(struct Flappy *game);
+void AtlasBuild(struct Flappy *game, struct Atlas *atlas);
+void AtlasFree(struct Flappy *game, struct Atlas *atlas);
+SDL_Texture *AtlasGetTexture(struct Atlas *atlas);
+const uint32_t *AtlasGetPixels(struct Atlas *atlas, int *w, int *h);
+const uint16_t *AtlasGetSpans(struct Atlas *atlas);
+void SpanTableBuild(uint16_t *span, const uint32_t *pix, int w, int h);
+struct Image *ImageFromPixels(struct Flappy *game, const void *pix, int w, int h);
+struct Image *ImageLoadFrom(struct Flappy *game, void *data, size_t sz);
+struct Image *ImageLoad(struct Flappy *game, const char *filename);
+SDL_Rect ImageGetRect(struct Image *img);
+const uint32_t *ImageGetPixels(struct Image *img);
+void ImageDraw(struct Flappy *game, struct Image *img, SDL_Rect clip, float x, float y);
+
+/* render state tracking */
+struct RenderState *RenderStateNew(struct Flappy *game);
+void RenderStateFree(struct RenderState *state);
+void RenderStateInvalidate(struct Flappy *game);
+void RenderStateForgetTexture(struct Flappy *game, SDL_Texture *tex);
+void RenderStateSetTarget(struct Flappy *game, SDL_Texture *target);
+void RenderStateSetDrawBlendMode(struct Flappy *game, SDL_BlendMode blend);
+void RenderStateSetTextureColorMod(struct Flappy *game, SDL_Texture *tex, uint8_t r, uint8_t g, uint8_t b);
+void RenderStateSetTextureAlphaMod(struct Flappy *game, SDL_Texture *tex, uint8_t a);
+void RenderStateSetTextureBlendMode(struct Flappy *game, SDL_Texture *tex, SDL_BlendMode blend);
+void RenderStateGetCounts(struct Flappy *game, unsigned *changes, unsigned *elided);
+
+/* sprite batching */
+struct Batch *BatchNew(struct Flappy *game);
+void BatchFree(struct Batch *batch);
+void BatchStartThread(struct Flappy *game);
+int BatchStopThread(struct Flappy *game);
+void BatchSetOutputSize(struct Flappy *game, int w, int h);
+void BatchInvalidate(struct Flappy *game);
+void BatchSetTarget(struct Flappy *game, SDL_Texture *target);
+void BatchSetColor(struct Flappy *game, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+SDL_Color BatchGetColor(struct Flappy *game);
+void BatchQuad(struct Flappy *game, SDL_Texture *tex, SDL_Rect clip, SDL_Rect dst);
+void BatchRect(struct Flappy *game, SDL_Rect rect);
+void BatchPresent(struct Flappy *game);
+struct BatchStats BatchGetStats(struct Flappy *game);
+
+/* software rasterizer */
+struct Software *SoftwareNew(struct Flappy *game);
+void SoftwareFree(struct Software *sw);
+void SoftwareQuads(struct Flappy *game, SDL_Texture *tex, const SDL_Vertex *vert, int quadNum);
+void SoftwareUpload(struct Flappy *game, SDL_Texture *dst);
+void SoftwareInvalidate(struct Flappy *game);
+const SDL_Rect *SoftwareGetDirty(struct Flappy *game, int *num);
+const uint32_t *SoftwareGetPixels(struct Flappy *game);
+int SoftwareValidate(void);
+
+/* frame capture */
+struct Capture *CaptureNew(struct Flappy *game, const char *path, const char *format);
+void CaptureFree(struct Capture *capture);
+void CaptureFrame(struct Flappy *game);
+
 /* spritesheets */
 struct Spritesheet *SpritesheetFromPixels(struct Flappy *game, const void *pix, int w, int h);
 struct Spritesheet *SpritesheetLoadFrom(struct Flappy *game, void *data, size_t sz);
@@ -210,7 +397,8 @@ void SpritesheetFree(struct Flappy *game, struct Spritesheet *sheet);
 void SpritesheetDraw(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col, float x, float y);
 void SpritesheetDrawScaled(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col, float x, float y, float scale);
 void SpritesheetDrawCentered(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col, float x, float y);
-SDL_Texture *SpritesheetGetTexture(struct Spritesheet *sheet);
+SDL_Texture *SpritesheetGetTexture(struct Flappy *game, struct Spritesheet *sheet);
+SDL_Rect SpritesheetGetClip(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col);
 SDL_Rect SpritesheetGetCentered(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col, int x, int y);
 
 /* world */
@@ -218,6 +406,7 @@ void WorldDraw(struct Flappy *game);
 void WorldDoHazards(struct Flappy *game);
 
 /* backgrounds */
+void BackgroundInit(struct Flappy *game);
 void BackgroundDrawFloor(struct Flappy *game);
 void BackgroundDraw(struct Flappy *game);
 
@@ -227,11 +416,13 @@ void ObstacleUpdateAll(struct Flappy *game);
 void ObstacleResetAll(struct Flappy *game);
 void ObstacleDrawAll(struct Flappy *game);
 void ObstacleCleanup(struct Flappy *game);
+void ObstacleGetCounts(struct Flappy *game, unsigned *live, unsigned *cap);
 
 /* particles */
 void ParticlePush(struct Flappy *game, enum ParticleType, float x, float y);
 void ParticleDrawAll(struct Flappy *game);
 void ParticleCleanup(struct Flappy *game);
+void ParticleGetCounts(struct Flappy *game, unsigned *live, unsigned *cap);
 
 /* player */
 struct Player *PlayerNew(struct Flappy *game);
@@ -243,24 +434,88 @@ void PlayerInit(struct Flappy *game, struct Player *player);
 float PlayerGetX(struct Player *player);
 void PlayerGetCenter(struct Player *player, float *x, float *y);
 
+/* parabolas */
+float ParabolaMotion(struct Parabola p, uint32_t milliseconds);
+void ParabolaBatch(const struct Parabola *parabola, int parabolaNum, const uint32_t *ticks, int ticksNum, void *out, enum ParabolaFormat format);
+int ParabolaBatchValidate(void);
+int ParabolaBatchBenchmark(void);
+
 /* user interface */
-void UiDrawButton(struct Flappy *game, int x, int y, enum FlappyButton icon);
+struct UiState *UiNew(struct Flappy *game);
+void UiFree(struct UiState *ui);
+void UiUpdate(struct Flappy *game);
+int UiIsHovering(struct Flappy *game);
+void UiSetCursor(struct Flappy *game);
 void UiDrawTitle(struct Flappy *game);
 void UiDraw(struct Flappy *game);
+void UiDrawCursor(struct Flappy *game);
+int UiDrawNumber(struct Flappy *game, unsigned value, int x, int y, float scale);
 
 /* input */
 void InputProcess(struct Flappy *game);
-enum FlappyMouse InputMouseInRect(struct Flappy *game, SDL_Rect rect);
+
+/* scripted input */
+struct InputSource *InputSourceNew(struct Flappy *game, const char *path);
+void InputSourceFree(struct InputSource *src);
+int InputSourcePoll(struct Flappy *game, SDL_Event *event);
 
 /* primitive geometry */
 void PrimitiveRect(struct Flappy *game, SDL_Rect r);
 void PrimitiveRectOutline(struct Flappy *game, SDL_Rect r);
+void PrimitiveRectsColored(struct Flappy *game, const SDL_Rect *rects, const SDL_Color *colors, int num);
 
 /* timer */
 struct Timer *TimerNew(struct Flappy *game);
 void TimerFree(struct Timer *timer);
 void TimerAdvance(struct Timer *timer, int isPaused);
 uint32_t TimerGetTicks(struct Timer *timer);
+double TimerGetTime(struct Timer *timer);
+double TimerGetTimeAt(struct Timer *timer, uint32_t timestamp);
+
+/* frame pacing */
+struct Pacer *PacerNew(struct Flappy *game);
+void PacerFree(struct Pacer *pacer);
+void PacerSetRate(struct Flappy *game, struct Pacer *pacer, unsigned rate);
+unsigned PacerGetRate(struct Pacer *pacer);
+void PacerWait(struct Flappy *game);
+
+/* histograms */
+void HistogramInit(struct Histogram *hist, double resolution);
+void HistogramAdd(struct Histogram *hist, double ms);
+double HistogramGetPercentile(const struct Histogram *hist, double percent);
+
+/* input latency */
+struct Latency *LatencyNew(struct Flappy *game);
+void LatencyFree(struct Latency *latency);
+void LatencyPress(struct Flappy *game, uint32_t timestamp);
+void LatencyFlap(struct Flappy *game);
+uint64_t LatencyTakeApplied(struct Flappy *game);
+void LatencyPresented(struct Flappy *game, uint64_t applied);
+void LatencyGetHistograms(struct Flappy *game, struct Histogram *toFlap, struct Histogram *toPresent);
+void LatencyReport(struct Flappy *game, FILE *fp);
+
+/* performance overlay */
+struct Hud *HudNew(struct Flappy *game);
+void HudFree(struct Hud *hud);
+void HudFrame(struct Flappy *game);
+void HudBegin(struct Flappy *game);
+void HudEnd(struct Flappy *game, enum HudPhase phase);
+void HudDraw(struct Flappy *game);
+
+/* frame profiler */
+#ifdef FLAPPY_PROFILE
+struct Profile *ProfileNew(struct Flappy *game, const char *path, int counters);
+void ProfileFree(struct Profile *profile);
+void ProfileBegin(struct Flappy *game, enum ProfileZone zone);
+void ProfileEnd(struct Flappy *game, enum ProfileZone zone);
+#endif
+
+/* timeline tracing */
+#ifdef FLAPPY_PROFILE
+struct Trace *TraceNew(const char *path);
+void TraceFree(struct Trace *trace);
+void TracePush(struct Flappy *game, char phase, const char *cat, const char *name, int value);
+#endif
 
 /* colors */
 void HsvToRgb(float h, float s, float v, float *r, float *g, float *b);
@@ -274,19 +529,22 @@ int CollisionPointRect(const int x, const int y, const SDL_Rect rect);
 void ColliderArenaInit(struct Flappy *game);
 void ColliderArenaProcess(struct Flappy *game);
 void ColliderArenaPush(struct Flappy *game, void *instance, ColliderCallback cb, const uint32_t color, const struct ColliderInit *init);
+void ColliderArenaGetCounts(struct Flappy *game, unsigned *live, unsigned *cap);
 void ColliderArenaDraw(struct Flappy *game, uint32_t bgcolor, uint32_t outlinecolor, const int opacity);
 const struct ColliderInit *ColliderInitRect(struct Flappy *game, const float x, const float y, const float w, const float h);
 
 /* flappy game context */
 void FlappyFatal(const char *fmt, ...);
-struct Flappy *FlappyNew(void);
+struct Flappy *FlappyNew(const char *trace, int software);
 int FlappyFree(struct Flappy *game);
 void FlappyUpdate(struct Flappy *game);
+void FlappyStep(struct Flappy *game);
 void FlappyInput(struct Flappy *game);
 void FlappyDraw(struct Flappy *game);
 unsigned FlappyGetWindowMaxSize(struct Flappy *game);
 void FlappyUpdateWindowSize(struct Flappy *game, int n);
 uint32_t FlappyRand(struct Flappy *game);
+uint32_t FlappyGetDrawTicks(struct Flappy *game, uint32_t since);
 void FlappyStartGame(struct Flappy *game);
 void FlappyGoTitle(struct Flappy *game);
 void FlappyGameOver(struct Flappy *game);
@@ -68,6 +68,23 @@ static void SetWindowIcon(struct Flappy *game)
 #endif
 }
 
+/* reset gameplay, entering `state` */
+static void FlappyReset(struct Flappy *game, enum FlappyState state)
+{
+	assert(game);
+	
+	game->playerflapped = 0;
+	game->paused = 0;
+	game->score = 0;
+	game->jabuHazardActive = 0;
+	game->state = state;
+	PlayerInit(game, game->player);
+	ObstacleResetAll(game);
+	
+	game->themeStartTime = game->stateStartTime = game->ticks;
+	game->stateTicks = 0;
+}
+
 /******************************
  *
  * public functions
@@ -114,6 +131,7 @@ void FlappyUpdateWindowSize(struct Flappy *game, int n)
 	struct Input *input;
 	unsigned scaleMax;
 	unsigned scale;
+	int threaded;
 	
 	assert(game);
 	assert(n == 1 || n == -1 || n == 0);
@@ -132,14 +150,28 @@ void FlappyUpdateWindowSize(struct Flappy *game, int n)
 	
 	scale = game->scale;
 	
+	/* the window mustn't change while the render thread is drawing to it */
+	threaded = BatchStopThread(game);
+	
 	/* synchronize cursor across window resizes */
 	SDL_WarpMouseInWindow(game->window, input->mouseX * scale, input->mouseY * scale);
 	
 	SDL_SetWindowSize(game->window, WINDOW_W * scale, WINDOW_H * scale);
+	BatchSetOutputSize(game, WINDOW_W * scale, WINDOW_H * scale);
+	
+	/* the hardware cursor scales with the window */
+	UiSetCursor(game);
+	
+	if (threaded)
+		BatchStartThread(game);
 }
 
-/* allocate and initialize a gameplay state */
-struct Flappy *FlappyNew(void)
+/* allocate and initialize a gameplay state; if `trace` isn't 0, a
+ * timeline trace is saved there, starting from the texture loads;
+ * if `software` isn't 0, SDL's software renderer is used, so the
+ * game's own rasterizer draws everything
+ */
+struct Flappy *FlappyNew(const char *trace, int software)
 {
 	struct Flappy *game = calloc(1, sizeof(*game));
 	
@@ -166,6 +198,13 @@ struct Flappy *FlappyNew(void)
 	if (!game)
 		FlappyFatal("memory error");
 	
+#ifdef FLAPPY_PROFILE
+	if (trace && !(game->trace = TraceNew(trace)))
+		FlappyFatal("memory error");
+#else
+	(void)trace;
+#endif
+	
 	if (SDL_Init(SDL_INIT_EVERYTHING))
 		SDL_ERR("SDL_Init");
 	
@@ -179,19 +218,64 @@ struct Flappy *FlappyNew(void)
 	)))
 		SDL_ERR("SDL_CreateWindow");
 	
-	if (!(game->renderer = SDL_CreateRenderer(
+	/* without a GPU (e.g. SDL_VIDEODRIVER=dummy), fall back to software */
+	if (!software)
+		game->renderer = SDL_CreateRenderer(
+			game->window
+			, -1
+			, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE
+		);
+	if (!game->renderer && !(game->renderer = SDL_CreateRenderer(
 		game->window
 		, -1
-		, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+		, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE
 	)))
 		SDL_ERR("SDL_CreateRenderer");
 	
-	game->backgrounds = TextureLoad(game, "gfx/backgrounds.png");
-	game->obstacles = TextureLoad(game, "gfx/obstacles.png");
-	game->particles = TextureLoad(game, "gfx/particles.png");
-	game->jabu = TextureLoad(game, "gfx/jabu.png");
+	if (!(game->renderState = RenderStateNew(game)))
+		FlappyFatal("memory error");
+	
+	/* everything is drawn at native resolution, then upscaled once */
+	if (!(game->frame = SDL_CreateTexture(
+		game->renderer
+		, SDL_PIXELFORMAT_ARGB8888
+		, SDL_TEXTUREACCESS_TARGET
+		, WINDOW_W
+		, WINDOW_H
+	)))
+		SDL_ERR("SDL_CreateTexture");
+	SDL_SetTextureScaleMode(game->frame, SDL_ScaleModeNearest);
+	
+	if (!(game->batch = BatchNew(game)))
+		FlappyFatal("memory error");
+	
+	/* load every image into one texture atlas */
+	if (!(game->atlas = AtlasNew(game)))
+		FlappyFatal("memory error");
+	game->backgrounds = ImageLoad(game, "gfx/backgrounds.png");
+	BackgroundInit(game);
+	game->obstacles = ImageLoad(game, "gfx/obstacles.png");
+	game->particles = ImageLoad(game, "gfx/particles.png");
+	game->jabu = ImageLoad(game, "gfx/jabu.png");
 	game->sprites = SpritesheetLoad(game, "gfx/sprites.png");
 	game->ui = SpritesheetLoad(game, "gfx/ui.png");
+	TRACE_BEGIN(game, "load", "atlas");
+	AtlasBuild(game, game->atlas);
+	TRACE_END(game, "load", "atlas");
+	
+	/* SDL's software renderer is slow at blending; do it ourselves */
+	{
+		SDL_RendererInfo info;
+		
+		if (!SDL_GetRendererInfo(game->renderer, &info)
+			&& (info.flags & SDL_RENDERER_SOFTWARE)
+			&& !(game->software = SoftwareNew(game))
+		)
+			FlappyFatal("memory error");
+	}
+	
+	if (!(game->uiState = UiNew(game)))
+		FlappyFatal("memory error");
 	
 	if (!(game->player = PlayerNew(game)))
 		FlappyFatal("memory error");
@@ -209,9 +293,21 @@ struct Flappy *FlappyNew(void)
 	if (!(game->timer = TimerNew(game)))
 		FlappyFatal("memory error");
 	
+	/* measure input latency */
+	if (!(game->latency = LatencyNew(game)))
+		FlappyFatal("memory error");
+	
+	/* create performance overlay */
+	if (!(game->hud = HudNew(game)))
+		FlappyFatal("memory error");
+	
+	/* create frame pacer */
+	if (!(game->pacer = PacerNew(game)))
+		FlappyFatal("memory error");
+	
 	/* set up cursor */
 	SDL_WarpMouseInWindow(game->window, WINDOW_W * WINDOW_SCALE * 0.75f, (WINDOW_H / 2) * WINDOW_SCALE);
-	SDL_ShowCursor(0);
+	UiSetCursor(game);
 	
 	/* set window icon */
 	SetWindowIcon(game);
@@ -227,23 +323,67 @@ uint32_t FlappyRand(struct Flappy *game)
 	return rnd_pcg_next(game->rnd_pcg);
 }
 
+/* returns the game time being drawn, in milliseconds since `since`;
+ * drawing trails the newest step by up to a step, so anything that
+ * began during that step hasn't begun yet as far as drawing goes
+ */
+uint32_t FlappyGetDrawTicks(struct Flappy *game, uint32_t since)
+{
+	assert(game);
+	
+	if ((int32_t)(game->drawTicks - since) < 0)
+		return 0;
+	
+	return game->drawTicks - since;
+}
+
 /* deallocate a gameplay state */
 int FlappyFree(struct Flappy *game)
 {
 	assert(game);
 	
-	TextureFree(game, game->backgrounds);
-	TextureFree(game, game->obstacles);
-	TextureFree(game, game->particles);
-	TextureFree(game, game->jabu);
+	/* nothing may be freed while it could still be drawn */
+	BatchStopThread(game);
+	if (game->capture)
+		CaptureFree(game->capture);
+	if (game->inputSource)
+		InputSourceFree(game->inputSource);
+#ifdef FLAPPY_PROFILE
+	if (game->profile)
+		ProfileFree(game->profile);
+	if (game->trace)
+		TraceFree(game->trace);
+#endif
+	
 	SpritesheetFree(game, game->sprites);
 	SpritesheetFree(game, game->ui);
+	UiFree(game->uiState);
+	AtlasFree(game, game->atlas);
 	
 	ObstacleCleanup(game);
 	ParticleCleanup(game);
 	PlayerFree(game->player);
 	TimerFree(game->timer);
+	PacerFree(game->pacer);
 	
+	/* report rendering statistics when debugging */
+	if (game->debug)
+	{
+		struct BatchStats stats = BatchGetStats(game);
+		
+		fprintf(stderr, "last frame: %u draw calls, %u quads, %u culled, %u state changes (%u elided)\n"
+			, stats.drawCalls, stats.quads, stats.culled, stats.stateChanges, stats.stateElided
+		);
+	}
+	LatencyReport(game, stderr);
+	LatencyFree(game->latency);
+	HudFree(game->hud);
+	
+	if (game->software)
+		SoftwareFree(game->software);
+	BatchFree(game->batch);
+	TextureFree(game, game->frame);
+	RenderStateFree(game->renderState);
 	SDL_DestroyRenderer(game->renderer);
 	SDL_DestroyWindow(game->window);
 	SDL_Quit();
@@ -253,18 +393,56 @@ int FlappyFree(struct Flappy *game)
 	return 0;
 }
 
-/* update a gameplay state */
+/* update a gameplay state; with a fixed simulation rate, as many steps
+ * are run as have fit into the time elapsed since the last update
+ */
 void FlappyUpdate(struct Flappy *game)
 {
+	double step;
+	double now;
+	int steps;
+	
 	assert(game);
 	
-	/* reduce CPU usage when window is minimized */
-	if (game->windowMinimized)
-		SDL_Delay(10);
+	PROFILE_BEGIN(game, PROFILE_UPDATE_TIMER);
+	TimerAdvance(game->timer, game->paused);
+	PROFILE_END(game, PROFILE_UPDATE_TIMER);
+	
+	/* one step per frame, covering however much time has passed */
+	if (!game->simRate)
+	{
+		game->ticks = TimerGetTicks(game->timer);
+		game->simAlpha = 1;
+		game->drawTicks = game->ticks;
+		FlappyStep(game);
+		return;
+	}
+	
+	step = 1000.0 / game->simRate;
+	now = TimerGetTime(game->timer);
+	
+	/* too far behind to catch up; drop the excess */
+	if (now - game->simTime > step * SIM_STEPS_MAX)
+		game->simTime = now - step * SIM_STEPS_MAX;
+	
+	for (steps = 0; game->simTime + step <= now; ++steps)
+	{
+		game->simTime += step;
+		game->ticks = game->simTime;
+		FlappyStep(game);
+	}
+	
+	/* rendering happens somewhere between the last two steps */
+	game->simAlpha = (now - game->simTime) / step;
+	game->drawTicks = SDL_max(game->simTime - step + game->simAlpha * step, 0);
+}
+
+/* advance gameplay to game->ticks */
+void FlappyStep(struct Flappy *game)
+{
+	assert(game);
 	
 	/* handle game timers */
-	TimerAdvance(game->timer, game->paused);
-	game->ticks = TimerGetTicks(game->timer);
 	game->stateTicks = game->ticks - game->stateStartTime;
 	game->themeTicks = game->ticks - game->themeStartTime;
 	
@@ -273,6 +451,7 @@ void FlappyUpdate(struct Flappy *game)
 		PlayerInit(game, game->player);
 	
 	/* initialize collision arena */
+	PROFILE_BEGIN(game, PROFILE_UPDATE_COLLIDERS);
 	ColliderArenaInit(game);
 	
 	/* ceiling */
@@ -280,67 +459,98 @@ void FlappyUpdate(struct Flappy *game)
 	
 	/* floor */
 	ColliderArenaPush(game, 0, 0, COLOR_WORLD, ColliderInitRect(game, 0, FLOOR_Y, WINDOW_W, WINDOW_H));
+	PROFILE_END(game, PROFILE_UPDATE_COLLIDERS);
 	
 	/* other hazards */
+	PROFILE_BEGIN(game, PROFILE_UPDATE_HAZARDS);
 	WorldDoHazards(game);
+	PROFILE_END(game, PROFILE_UPDATE_HAZARDS);
 	
 	/* obstacles appear in every mode except title screen */
+	PROFILE_BEGIN(game, PROFILE_UPDATE_OBSTACLES);
 	if (game->state != FLAPPY_STATE_TITLE)
 		ObstacleUpdateAll(game);
+	PROFILE_END(game, PROFILE_UPDATE_OBSTACLES);
 	
 	/* run main player function */
+	PROFILE_BEGIN(game, PROFILE_UPDATE_PLAYER);
 	PlayerUpdate(game, game->player);
+	PROFILE_END(game, PROFILE_UPDATE_PLAYER);
 	
 	/* process all colliders registered during this frame */
+	PROFILE_BEGIN(game, PROFILE_UPDATE_ARENA);
 	ColliderArenaProcess(game);
+	PROFILE_END(game, PROFILE_UPDATE_ARENA);
+	
+	/* a press is seen by exactly one step, however many frames
+	 * pass before that step runs
+	 */
+	game->input.pressed = 0;
 }
 
 /* input wrapper */
 void FlappyInput(struct Flappy *game)
 {
+	PROFILE_BEGIN(game, PROFILE_INPUT);
 	InputProcess(game);
+	PROFILE_END(game, PROFILE_INPUT);
+	UiUpdate(game);
 }
 
 /* display current gameplay frame */
 void FlappyDraw(struct Flappy *game)
 {
+	SDL_Rect frame = {0, 0, WINDOW_W, WINDOW_H};
+	SDL_Rect window = {0, 0, WINDOW_W * game->scale, WINDOW_H * game->scale};
+	
+	assert(game);
+	
+	/* draw into the native resolution frame */
+	BatchSetTarget(game, game->frame);
+	
 	/* draw the game world */
+	PROFILE_BEGIN(game, PROFILE_DRAW_WORLD);
 	WorldDraw(game);
 	
 	/* display colliders */
 	if (game->debug & FLAPPY_DEBUG_COLLISION)
 		ColliderArenaDraw(game, 0xffaaaaaa, 0x000000ff, 0xff);
+	PROFILE_END(game, PROFILE_DRAW_WORLD);
 	
 	/* draw the title screen */
+	PROFILE_BEGIN(game, PROFILE_DRAW_UI);
 	UiDraw(game);
+	PROFILE_END(game, PROFILE_DRAW_UI);
+	
+	/* upscale the frame to the window in one copy */
+	PROFILE_BEGIN(game, PROFILE_DRAW_PRESENT);
+	BatchSetTarget(game, 0);
+	BatchQuad(game, game->frame, frame, window);
+	
+	/* the performance overlay and cursor are drawn at window resolution */
+	if (game->debug & FLAPPY_DEBUG_PERF)
+		HudDraw(game);
+	UiDrawCursor(game);
 	
-	/* display result to screen */
-	SDL_RenderPresent(game->renderer);
+	/* submit batched drawing and display result to screen */
+	BatchPresent(game);
+	PROFILE_END(game, PROFILE_DRAW_PRESENT);
 }
 
 /* (re)initialize gameplay */
 void FlappyStartGame(struct Flappy *game)
 {
-	game->playerflapped = 0;
-	game->paused = 0;
-	game->score = 0;
-	game->jabuHazardActive = 0;
-	game->state = FLAPPY_STATE_PLAYING;
-	PlayerInit(game, game->player);
-	ObstacleResetAll(game);
+	FlappyReset(game, FLAPPY_STATE_PLAYING);
 	
-	game->themeStartTime = game->stateStartTime = game->ticks;
-	game->stateTicks = 0;
+	TRACE_INSTANT(game, "state", "play", game->theme);
 }
 
 /* return to title screen */
 void FlappyGoTitle(struct Flappy *game)
 {
-	FlappyStartGame(game);
-	game->state = FLAPPY_STATE_TITLE;
+	FlappyReset(game, FLAPPY_STATE_TITLE);
 	
-	game->stateStartTime = game->ticks;
-	game->stateTicks = 0;
+	TRACE_INSTANT(game, "state", "title", 0);
 }
 
 /* set game over state */
@@ -357,12 +567,16 @@ void FlappyGameOver(struct Flappy *game)
 	
 	game->stateStartTime = game->ticks;
 	game->stateTicks = 0;
+	
+	TRACE_INSTANT(game, "state", "game over", game->score);
 }
 
 /* toggle pause/unpause */
 void FlappyGamePause(struct Flappy *game)
 {
 	game->paused = !game->paused;
+	
+	TRACE_INSTANT(game, "state", "pause", game->paused);
 }
 
 /* themes */
@@ -372,5 +586,7 @@ void FlappyNextTheme(struct Flappy *game)
 	game->themeStartTime = game->ticks;
 	game->theme += 1;
 	game->theme %= FLAPPY_THEME_MAX;
+	
+	TRACE_INSTANT(game, "theme", "theme", game->theme);
 }
 
@@ -0,0 +1,112 @@
+/*
+ * histogram.c <z64.me>
+ *
+ * histograms of durations, for reporting percentiles
+ * without keeping every sample around; buckets are exact
+ * up to 64 units, then 32 per doubling (about 3% error)
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define HISTOGRAM_SUB  32 /* buckets per doubling */
+
+/* returns the bucket holding `units` */
+static unsigned HistogramBucket(uint64_t units)
+{
+	unsigned shift = 0;
+	unsigned bucket;
+	
+	while ((units >> shift) >= HISTOGRAM_SUB * 2)
+		++shift;
+	
+	bucket = HISTOGRAM_SUB * shift + (units >> shift);
+	
+	return SDL_min(bucket, HISTOGRAM_BUCKETS - 1);
+}
+
+/* returns the first value past the end of `bucket`, in units */
+static double HistogramBucketEnd(unsigned bucket)
+{
+	unsigned shift;
+	
+	if (bucket < HISTOGRAM_SUB * 2)
+		return bucket + 1;
+	
+	shift = bucket / HISTOGRAM_SUB - 1;
+	
+	return ldexp(bucket - HISTOGRAM_SUB * shift + 1, shift);
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* reset a histogram whose smallest buckets are `resolution` milliseconds wide */
+void HistogramInit(struct Histogram *hist, double resolution)
+{
+	assert(hist);
+	assert(resolution > 0);
+	
+	memset(hist, 0, sizeof(*hist));
+	hist->resolution = resolution;
+}
+
+/* add a duration, in milliseconds */
+void HistogramAdd(struct Histogram *hist, double ms)
+{
+	double units;
+	
+	assert(hist);
+	
+	if (ms < 0)
+		ms = 0;
+	
+	/* past the last bucket, it still counts toward the maximum */
+	units = SDL_min(ms / hist->resolution, (double)((uint64_t)1 << 62));
+	
+	hist->bucket[HistogramBucket(units)] += 1;
+	hist->count += 1;
+	hist->sum += ms;
+	if (ms > hist->max)
+		hist->max = ms;
+}
+
+/* returns the duration that `percent` percent of samples are at or
+ * under, to within the histogram's precision (0 if it's empty)
+ */
+double HistogramGetPercentile(const struct Histogram *hist, double percent)
+{
+	uint64_t want;
+	uint64_t seen = 0;
+	unsigned i;
+	
+	assert(hist);
+	
+	if (!hist->count)
+		return 0;
+	
+	want = ceil(hist->count * percent / 100);
+	if (!want)
+		want = 1;
+	
+	for (i = 0; i < HISTOGRAM_BUCKETS; ++i)
+	{
+		seen += hist->bucket[i];
+		
+		/* report the top of the bucket, but never past the maximum */
+		if (seen >= want)
+			return SDL_min(HistogramBucketEnd(i) * hist->resolution, hist->max);
+	}
+	
+	return hist->max;
+}
@@ -0,0 +1,321 @@
+/*
+ * hud.c <z64.me>
+ *
+ * performance overlay, one of the F12 debugging options;
+ * it's drawn with the score digits at window resolution,
+ * in rows from the top left corner of the window:
+ *   frame time in ms: this frame, average, worst
+ *   average ms spent simulating, then drawing
+ *   colliders, particles, obstacles: in use, then allocated
+ *   draw calls and quads in the last frame
+ *   input latency from press to present in ms: median, 99th percentile
+ * averages and worsts cover the last second; latencies cover every
+ * flap so far
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define HUD_SAMPLES     1024 /* most frames remembered */
+#define HUD_WINDOW_MS   1000 /* frames older than this are forgotten */
+#define HUD_SCALE       0.25f /* digit size relative to game pixels, down to 1 window pixel */
+#define HUD_GAP         8    /* sprite pixels between numbers */
+#define HUD_COLOR_DIM   0xa0a0a0 /* rgb888 for allocation counts */
+#define HUD_COLOR_WORST 0xff8080 /* rgb888 for worst frame time */
+#define HUD_COLOR_SIM   0x80ff80 /* rgb888 for simulation time */
+#define HUD_COLOR_DRAW  0x80c0ff /* rgb888 for drawing time */
+#define HUD_COLOR_LATENCY 0xffe080 /* rgb888 for input latency */
+
+struct HudSample
+{
+	uint64_t            when;      /* performance counter at end of frame */
+	float               frame;     /* ms from start to end of frame */
+	float               phase[HUD_PHASE_MAX]; /* ms spent in each phase */
+};
+
+struct Hud
+{
+	uint64_t            freq;      /* performance counter frequency */
+	uint64_t            frameStart; /* when this frame began (0 = overlay was off) */
+	uint64_t            phaseStart; /* when the open phase began */
+	float               phase[HUD_PHASE_MAX]; /* ms spent in each phase this frame */
+	struct HudSample    sample[HUD_SAMPLES]; /* ring of finished frames */
+	int                 sampleNext;
+	int                 sampleNum;
+};
+
+/* what the overlay shows about frame times */
+struct HudSummary
+{
+	float               frame;     /* most recent frame */
+	float               frameAvg;
+	float               frameWorst;
+	float               phaseAvg[HUD_PHASE_MAX];
+};
+
+/* summarize the frames that finished within the last second */
+static struct HudSummary HudSummarize(struct Hud *hud)
+{
+	struct HudSummary sum = {0};
+	uint64_t window;
+	uint64_t now;
+	int num;
+	int i;
+	
+	assert(hud);
+	
+	if (!hud->sampleNum)
+		return sum;
+	
+	now = SDL_GetPerformanceCounter();
+	window = hud->freq * HUD_WINDOW_MS / 1000;
+	
+	for (num = 0; num < hud->sampleNum; ++num)
+	{
+		const struct HudSample *s = &hud->sample[(hud->sampleNext - 1 - num + HUD_SAMPLES) % HUD_SAMPLES];
+		
+		/* the most recent frame counts even if it's old, so the
+		 * overlay isn't blank after a long stall
+		 */
+		if (num && now - s->when > window)
+			break;
+		
+		if (!num)
+			sum.frame = s->frame;
+		sum.frameAvg += s->frame;
+		sum.frameWorst = SDL_max(sum.frameWorst, s->frame);
+		for (i = 0; i < HUD_PHASE_MAX; ++i)
+			sum.phaseAvg[i] += s->phase[i];
+	}
+	
+	sum.frameAvg /= num;
+	for (i = 0; i < HUD_PHASE_MAX; ++i)
+		sum.phaseAvg[i] /= num;
+	
+	return sum;
+}
+
+/* set the batch color from an rgb888 value */
+static void HudSetColor(struct Flappy *game, uint32_t rgb, uint8_t a)
+{
+	assert(game);
+	
+	BatchSetColor(game, rgb >> 16, rgb >> 8, rgb, a);
+}
+
+/* draw a duration in milliseconds to one decimal place; returns its width */
+static int HudDrawMs(struct Flappy *game, float ms, int x, int y, float scale)
+{
+	SDL_Rect dot;
+	SDL_Color old;
+	unsigned tenths;
+	int start = x;
+	int h;
+	
+	assert(game);
+	
+	tenths = SDL_min(ms, 999.9f) * 10 + 0.5f;
+	h = SpritesheetGetClip(game, game->ui, 1, 6).h * scale;
+	
+	x += UiDrawNumber(game, tenths / 10, x, y, scale);
+	
+	/* decimal point, outlined like the digits */
+	dot.w = dot.h = SDL_max(4 * scale, 3);
+	dot.x = x;
+	dot.y = y + h - dot.h;
+	old = BatchGetColor(game);
+	BatchSetColor(game, 0, 0, 0, old.a);
+	PrimitiveRect(game, dot);
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
+	PrimitiveRect(game, (SDL_Rect){dot.x + 1, dot.y + 1, dot.w - 2, dot.h - 2});
+	x += dot.w + 2 * scale;
+	
+	x += UiDrawNumber(game, tenths % 10, x, y, scale);
+	
+	return x - start;
+}
+
+/* draw an in use and allocated count pair; returns its width */
+static int HudDrawCounts(struct Flappy *game, unsigned live, unsigned cap, int x, int y, float scale)
+{
+	SDL_Color old;
+	int start = x;
+	
+	assert(game);
+	
+	old = BatchGetColor(game);
+	
+	x += UiDrawNumber(game, live, x, y, scale);
+	x += HUD_GAP / 2 * scale;
+	HudSetColor(game, HUD_COLOR_DIM, old.a);
+	x += UiDrawNumber(game, cap, x, y, scale);
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
+	
+	return x - start;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate the performance overlay */
+struct Hud *HudNew(struct Flappy *game)
+{
+	struct Hud *hud = calloc(1, sizeof(*hud));
+	
+	assert(game);
+	
+	if (!hud)
+		return 0;
+	
+	hud->freq = SDL_GetPerformanceFrequency();
+	
+	return hud;
+}
+
+/* deallocate the performance overlay */
+void HudFree(struct Hud *hud)
+{
+	assert(hud);
+	
+	free(hud);
+}
+
+/* a new frame is starting; frames are only timed while the overlay is on */
+void HudFrame(struct Flappy *game)
+{
+	struct Hud *hud;
+	uint64_t now;
+	
+	assert(game);
+	assert(game->hud);
+	
+	hud = game->hud;
+	
+	if (!(game->debug & FLAPPY_DEBUG_PERF))
+	{
+		hud->frameStart = 0;
+		return;
+	}
+	
+	now = SDL_GetPerformanceCounter();
+	
+	/* finish the previous frame */
+	if (hud->frameStart)
+	{
+		struct HudSample *s = &hud->sample[hud->sampleNext];
+		
+		s->when = now;
+		s->frame = (double)(now - hud->frameStart) * 1000 / hud->freq;
+		memcpy(s->phase, hud->phase, sizeof(s->phase));
+		hud->sampleNext = (hud->sampleNext + 1) % HUD_SAMPLES;
+		hud->sampleNum = SDL_min(hud->sampleNum + 1, HUD_SAMPLES);
+	}
+	
+	hud->frameStart = now;
+	memset(hud->phase, 0, sizeof(hud->phase));
+}
+
+/* start timing a phase of the frame */
+void HudBegin(struct Flappy *game)
+{
+	assert(game);
+	assert(game->hud);
+	
+	if (game->debug & FLAPPY_DEBUG_PERF)
+		game->hud->phaseStart = SDL_GetPerformanceCounter();
+}
+
+/* finish timing a phase of the frame */
+void HudEnd(struct Flappy *game, enum HudPhase phase)
+{
+	struct Hud *hud;
+	
+	assert(game);
+	assert(game->hud);
+	assert(phase < HUD_PHASE_MAX);
+	
+	hud = game->hud;
+	
+	if (game->debug & FLAPPY_DEBUG_PERF)
+		hud->phase[phase] += (double)(SDL_GetPerformanceCounter() - hud->phaseStart) * 1000 / hud->freq;
+}
+
+/* draw the performance overlay; this happens after the frame has been
+ * upscaled to the window, so the digits can be smaller than game pixels
+ */
+void HudDraw(struct Flappy *game)
+{
+	struct HudSummary sum;
+	struct BatchStats stats;
+	struct Histogram latency;
+	SDL_Color old;
+	unsigned live;
+	unsigned cap;
+	float scale;
+	int gap;
+	int line;
+	int x;
+	int y;
+	
+	assert(game);
+	assert(game->hud);
+	
+	sum = HudSummarize(game->hud);
+	stats = BatchGetStats(game);
+	
+	scale = SDL_max(game->scale * HUD_SCALE, 1);
+	gap = HUD_GAP * scale;
+	line = SpritesheetGetClip(game, game->ui, 1, 6).h * scale + gap / 2;
+	old = BatchGetColor(game);
+	
+	/* frame times */
+	x = y = 2 * game->scale;
+	x += HudDrawMs(game, sum.frame, x, y, scale) + gap;
+	x += HudDrawMs(game, sum.frameAvg, x, y, scale) + gap;
+	HudSetColor(game, HUD_COLOR_WORST, old.a);
+	HudDrawMs(game, sum.frameWorst, x, y, scale);
+	
+	/* simulation versus drawing */
+	x = 2 * game->scale;
+	y += line;
+	HudSetColor(game, HUD_COLOR_SIM, old.a);
+	x += HudDrawMs(game, sum.phaseAvg[HUD_PHASE_SIM], x, y, scale) + gap;
+	HudSetColor(game, HUD_COLOR_DRAW, old.a);
+	HudDrawMs(game, sum.phaseAvg[HUD_PHASE_DRAW], x, y, scale);
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
+	
+	/* entities */
+	x = 2 * game->scale;
+	y += line;
+	ColliderArenaGetCounts(game, &live, &cap);
+	x += HudDrawCounts(game, live, cap, x, y, scale) + gap * 2;
+	ParticleGetCounts(game, &live, &cap);
+	x += HudDrawCounts(game, live, cap, x, y, scale) + gap * 2;
+	ObstacleGetCounts(game, &live, &cap);
+	HudDrawCounts(game, live, cap, x, y, scale);
+	
+	/* rendering */
+	x = 2 * game->scale;
+	y += line;
+	x += UiDrawNumber(game, stats.drawCalls, x, y, scale) + gap;
+	UiDrawNumber(game, stats.quads, x, y, scale);
+	
+	/* input latency */
+	x = 2 * game->scale;
+	y += line;
+	LatencyGetHistograms(game, 0, &latency);
+	HudSetColor(game, HUD_COLOR_LATENCY, old.a);
+	x += HudDrawMs(game, HistogramGetPercentile(&latency, 50), x, y, scale) + gap;
+	HudDrawMs(game, HistogramGetPercentile(&latency, 99), x, y, scale);
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
+}
@@ -24,7 +24,9 @@ void InputProcess(struct Flappy *game)
 		input->mouseDown = 0;
 	}
 	
-	while(SDL_PollEvent(&event))
+	while (SDL_PollEvent(&event)
+		|| (game->inputSource && InputSourcePoll(game, &event))
+	)
 	{
 		
 		switch (event.type)
@@ -44,9 +46,27 @@ void InputProcess(struct Flappy *game)
 					case SDL_WINDOWEVENT_MINIMIZED:
 						game->windowMinimized = 1;
 						break;
+					
+					/* window has a new size */
+					case SDL_WINDOWEVENT_SIZE_CHANGED:
+						BatchSetOutputSize(game, event.window.data1, event.window.data2);
+						break;
+					
+					/* window contents were lost; idle frames
+					 * skip presenting, so make sure one doesn't
+					 */
+					case SDL_WINDOWEVENT_EXPOSED:
+						BatchInvalidate(game);
+						break;
 				}
 				break;
 			
+			/* renderer lost its state; don't trust what's cached */
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				BatchInvalidate(game);
+				break;
+			
 			/* cursor/mouse motion */
 			case SDL_MOUSEMOTION:
 				input->mouseX = (float)event.motion.x / game->scale;
@@ -57,8 +77,11 @@ void InputProcess(struct Flappy *game)
 			case SDL_MOUSEBUTTONDOWN:
 				input->clickX = input->mouseX;
 				input->clickY = input->mouseY;
+				input->clickStamp = event.button.timestamp;
+				LatencyPress(game, event.button.timestamp);
 				input->mouseDown = 1;
 				input->clicked = 0;
+				input->pressed = 1;
 				break;
 			
 			/* mouse button release */
@@ -99,35 +122,3 @@ void InputProcess(struct Flappy *game)
 		}
 	}
 }
-
-enum FlappyMouse InputMouseInRect(struct Flappy *game, SDL_Rect rect)
-{
-	struct Input *input;
-	enum FlappyMouse result = 0;
-	
-	assert(game);
-	
-	input = &game->input;
-	
-	/* user's cursor is hovering rectangle */
-	if (CollisionPointRect(input->mouseX, input->mouseY, rect))
-		result |= FLAPPY_MOUSE_HOVERING;
-	
-	/* user is in the process of clicking rectangle */
-	if (input->mouseDown && CollisionPointRect(input->clickX, input->clickY, rect))
-		result |= FLAPPY_MOUSE_CLICKING;
-	
-	/* user has successfully clicked the rectangle */
-	if (input->clicked)
-	{
-		if ((result & FLAPPY_MOUSE_CLICKING) && (result & FLAPPY_MOUSE_HOVERING))
-		{
-			input->clicked = 0;
-			input->mouseDown = 0;
-			result |= FLAPPY_MOUSE_CLICKED;
-		}
-	}
-	
-	return result;
-}
-
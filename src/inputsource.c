@@ -0,0 +1,340 @@
+/*
+ * inputsource.c <z64.me>
+ *
+ * scripted input: timestamped events are read from a file
+ * or a pipe and delivered alongside SDL's own, so the game
+ * can be driven with no display or player attached
+ *
+ * each line of a script is a time in milliseconds since
+ * the script started, then one of these commands:
+ *   move X Y   move cursor to X, Y (game pixels, not window)
+ *   down       press mouse button
+ *   up         release mouse button
+ *   key NAME   press and release F1, F2, or F12
+ *   quit       exit game
+ * blank lines and lines starting with '#' are ignored
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+enum InputSourceType
+{
+	INPUT_SOURCE_MOVE
+	, INPUT_SOURCE_DOWN
+	, INPUT_SOURCE_UP
+	, INPUT_SOURCE_KEY
+	, INPUT_SOURCE_QUIT
+};
+
+struct InputSourceEvent
+{
+	uint32_t              ms;      /* when, relative to start of script */
+	enum InputSourceType  type;
+	int                   x;       /* cursor position, for moves */
+	int                   y;
+	SDL_Keycode           key;     /* for key presses */
+};
+
+struct InputSource
+{
+	FILE                    *fp;
+	const char              *name;    /* for error messages */
+	uint32_t                 start;   /* SDL_GetTicks() when script started */
+	SDL_Thread              *thread;  /* reads and parses script */
+	SDL_mutex               *lock;    /* guards everything below */
+	struct InputSourceEvent *event;   /* parsed events, in order */
+	int                      eventNum;
+	int                      eventCap;
+	int                      next;    /* next event to deliver */
+	SDL_Event                keyUp;   /* release following a key press */
+	int                      keyUpPending;
+	int                      done;    /* no more events are coming */
+	int                      failed;  /* reading stopped at `error` */
+	char                     error[256]; /* reported by InputSourcePoll() */
+};
+
+/* stop reading with an error; the reader thread can't exit the game,
+ * so it's raised once the game has polled every event before it;
+ * returns -1
+ */
+static int InputSourceError(struct InputSource *src, const char *fmt, ...)
+{
+	va_list args;
+	
+	assert(src);
+	assert(fmt);
+	
+	va_start(args, fmt);
+	vsnprintf(src->error, sizeof(src->error), fmt, args);
+	va_end(args);
+	
+	SDL_LockMutex(src->lock);
+	src->failed = 1;
+	src->done = 1;
+	SDL_UnlockMutex(src->lock);
+	
+	return -1;
+}
+
+/* parse one script line into `ev`; returns 0 for lines with no event,
+ * or -1 if the line is malformed
+ */
+static int InputSourceParse(struct InputSource *src, const char *line, int lineNum, struct InputSourceEvent *ev)
+{
+	char cmd[16];
+	char arg[16];
+	unsigned ms;
+	int n;
+	
+	assert(src);
+	assert(line);
+	assert(ev);
+	
+	while (*line == ' ' || *line == '\t')
+		++line;
+	if (!*line || *line == '\n' || *line == '\r' || *line == '#')
+		return 0;
+	
+	memset(ev, 0, sizeof(*ev));
+	if (sscanf(line, "%u %15s%n", &ms, cmd, &n) != 2)
+		return InputSourceError(src, "%s:%d: expected time and command", src->name, lineNum);
+	ev->ms = ms;
+	line += n;
+	
+	if (!strcmp(cmd, "move"))
+	{
+		ev->type = INPUT_SOURCE_MOVE;
+		if (sscanf(line, "%d %d", &ev->x, &ev->y) != 2)
+			return InputSourceError(src, "%s:%d: 'move' needs coordinates", src->name, lineNum);
+	}
+	else if (!strcmp(cmd, "down"))
+		ev->type = INPUT_SOURCE_DOWN;
+	else if (!strcmp(cmd, "up"))
+		ev->type = INPUT_SOURCE_UP;
+	else if (!strcmp(cmd, "quit"))
+		ev->type = INPUT_SOURCE_QUIT;
+	else if (!strcmp(cmd, "key"))
+	{
+		ev->type = INPUT_SOURCE_KEY;
+		if (sscanf(line, "%15s", arg) != 1)
+			return InputSourceError(src, "%s:%d: 'key' needs a key name", src->name, lineNum);
+		if (!strcmp(arg, "F1"))
+			ev->key = SDLK_F1;
+		else if (!strcmp(arg, "F2"))
+			ev->key = SDLK_F2;
+		else if (!strcmp(arg, "F12"))
+			ev->key = SDLK_F12;
+		else
+			return InputSourceError(src, "%s:%d: unknown key '%s'", src->name, lineNum, arg);
+	}
+	else
+		return InputSourceError(src, "%s:%d: unknown command '%s'", src->name, lineNum, cmd);
+	
+	return 1;
+}
+
+/* reader thread: reading a pipe can block, so it's done here, and
+ * parsed events are queued for InputSourcePoll()
+ */
+static int InputSourceThread(void *udata)
+{
+	struct InputSource *src = udata;
+	char line[256];
+	int lineNum = 0;
+	
+	assert(src);
+	
+	while (fgets(line, sizeof(line), src->fp))
+	{
+		struct InputSourceEvent ev;
+		int n;
+		
+		if (!(n = InputSourceParse(src, line, ++lineNum, &ev)))
+			continue;
+		if (n < 0)
+			return 0;
+		
+		SDL_LockMutex(src->lock);
+		if (src->eventNum == src->eventCap)
+		{
+			struct InputSourceEvent *event;
+			int cap = src->eventCap ? src->eventCap * 2 : 64;
+			
+			if (!(event = realloc(src->event, cap * sizeof(*event))))
+			{
+				SDL_UnlockMutex(src->lock);
+				InputSourceError(src, "memory error");
+				return 0;
+			}
+			src->event = event;
+			src->eventCap = cap;
+		}
+		src->event[src->eventNum++] = ev;
+		SDL_UnlockMutex(src->lock);
+	}
+	
+	SDL_LockMutex(src->lock);
+	src->done = 1;
+	SDL_UnlockMutex(src->lock);
+	
+	return 0;
+}
+
+/* convert a script event into an SDL event */
+static void InputSourceToSDL(struct Flappy *game, const struct InputSourceEvent *ev, uint32_t timestamp, SDL_Event *event)
+{
+	assert(game);
+	assert(ev);
+	assert(event);
+	
+	memset(event, 0, sizeof(*event));
+	
+	switch (ev->type)
+	{
+		case INPUT_SOURCE_MOVE:
+			event->type = SDL_MOUSEMOTION;
+			event->motion.x = ev->x * game->scale;
+			event->motion.y = ev->y * game->scale;
+			break;
+		
+		case INPUT_SOURCE_DOWN:
+		case INPUT_SOURCE_UP:
+			event->type = ev->type == INPUT_SOURCE_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+			event->button.button = SDL_BUTTON_LEFT;
+			event->button.x = game->input.mouseX * game->scale;
+			event->button.y = game->input.mouseY * game->scale;
+			break;
+		
+		case INPUT_SOURCE_KEY:
+			event->type = SDL_KEYDOWN;
+			event->key.keysym.sym = ev->key;
+			break;
+		
+		case INPUT_SOURCE_QUIT:
+			event->type = SDL_QUIT;
+			break;
+	}
+	
+	event->common.timestamp = timestamp;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* start reading a script of input events from `path` ("-" = stdin) */
+struct InputSource *InputSourceNew(struct Flappy *game, const char *path)
+{
+	struct InputSource *src = calloc(1, sizeof(*src));
+	
+	assert(game);
+	assert(path);
+	
+	if (!src)
+		return 0;
+	
+	src->name = path;
+	if (!strcmp(path, "-"))
+		src->fp = stdin;
+	else if (!(src->fp = fopen(path, "r")))
+		FlappyFatal("failed to open input script '%s'", path);
+	
+	if (!(src->lock = SDL_CreateMutex()))
+		SDL_ERR("SDL_CreateMutex");
+	
+	src->start = SDL_GetTicks();
+	if (!(src->thread = SDL_CreateThread(InputSourceThread, "input", src)))
+		SDL_ERR("SDL_CreateThread");
+	
+	return src;
+}
+
+/* stop reading a script; a pipe that's still open is left to
+ * the operating system to clean up
+ */
+void InputSourceFree(struct InputSource *src)
+{
+	int done;
+	
+	assert(src);
+	
+	SDL_LockMutex(src->lock);
+	done = src->done;
+	SDL_UnlockMutex(src->lock);
+	
+	/* the reader may be blocked on a pipe, so only wait for it if it's finished */
+	if (done)
+	{
+		SDL_WaitThread(src->thread, 0);
+		if (src->fp != stdin)
+			fclose(src->fp);
+		SDL_DestroyMutex(src->lock);
+		free(src->event);
+		free(src);
+	}
+	else
+		SDL_DetachThread(src->thread);
+}
+
+/* get the next scripted event that's due, if any; returns non-zero
+ * if `event` was filled in
+ */
+int InputSourcePoll(struct Flappy *game, SDL_Event *event)
+{
+	struct InputSource *src;
+	struct InputSourceEvent ev;
+	uint32_t now;
+	
+	assert(game);
+	assert(game->inputSource);
+	assert(event);
+	
+	src = game->inputSource;
+	
+	/* a key press is released on the next poll */
+	if (src->keyUpPending)
+	{
+		*event = src->keyUp;
+		src->keyUpPending = 0;
+		return 1;
+	}
+	
+	now = SDL_GetTicks() - src->start;
+	
+	SDL_LockMutex(src->lock);
+	
+	/* the events before the error are delivered first */
+	if (src->failed && src->next == src->eventNum)
+	{
+		SDL_UnlockMutex(src->lock);
+		FlappyFatal("%s", src->error);
+	}
+	if (src->next == src->eventNum || src->event[src->next].ms > now)
+	{
+		SDL_UnlockMutex(src->lock);
+		return 0;
+	}
+	ev = src->event[src->next++];
+	SDL_UnlockMutex(src->lock);
+	
+	InputSourceToSDL(game, &ev, src->start + ev.ms, event);
+	
+	if (event->type == SDL_KEYDOWN)
+	{
+		src->keyUp = *event;
+		src->keyUp.type = SDL_KEYUP;
+		src->keyUpPending = 1;
+	}
+	
+	return 1;
+}
@@ -0,0 +1,183 @@
+/*
+ * latency.c <z64.me>
+ *
+ * input latency measurement: each mouse press that makes
+ * the player flap is followed from the event, through the
+ * simulation step that applies it, to the present that
+ * first shows it on screen
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define LATENCY_RESOLUTION  0.01 /* smallest histogram bucket, in milliseconds */
+
+struct Latency
+{
+	uint64_t            freq;      /* performance counter frequency */
+	uint64_t            press;     /* when the newest press happened (0 = none) */
+	uint64_t            applied;   /* a press that has made the player flap (0 = none) */
+	struct Histogram    toFlap;    /* press to simulation step that applied it */
+	struct Histogram    toPresent; /* press to present that displayed it */
+	SDL_SpinLock        lock;      /* histograms are added to while rendering */
+};
+
+/* returns milliseconds from performance counter `start` to now */
+static double LatencyElapsed(struct Latency *latency, uint64_t start)
+{
+	assert(latency);
+	
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000 / latency->freq;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate an input latency tracker */
+struct Latency *LatencyNew(struct Flappy *game)
+{
+	struct Latency *latency = calloc(1, sizeof(*latency));
+	
+	assert(game);
+	
+	if (!latency)
+		return 0;
+	
+	latency->freq = SDL_GetPerformanceFrequency();
+	HistogramInit(&latency->toFlap, LATENCY_RESOLUTION);
+	HistogramInit(&latency->toPresent, LATENCY_RESOLUTION);
+	
+	return latency;
+}
+
+/* deallocate an input latency tracker */
+void LatencyFree(struct Latency *latency)
+{
+	assert(latency);
+	
+	free(latency);
+}
+
+/* the mouse was pressed at SDL timestamp `timestamp` */
+void LatencyPress(struct Flappy *game, uint32_t timestamp)
+{
+	struct Latency *latency;
+	uint64_t age;
+	
+	assert(game);
+	assert(game->latency);
+	
+	latency = game->latency;
+	
+	/* events wait in SDL's queue until they're polled */
+	age = (uint32_t)(SDL_GetTicks() - timestamp);
+	latency->press = SDL_GetPerformanceCounter() - age * latency->freq / 1000;
+}
+
+/* the player flapped in response to the last press */
+void LatencyFlap(struct Flappy *game)
+{
+	struct Latency *latency;
+	
+	assert(game);
+	assert(game->latency);
+	
+	latency = game->latency;
+	
+	if (!latency->press)
+		return;
+	
+	SDL_AtomicLock(&latency->lock);
+	HistogramAdd(&latency->toFlap, LatencyElapsed(latency, latency->press));
+	SDL_AtomicUnlock(&latency->lock);
+	
+	latency->applied = latency->press;
+	latency->press = 0;
+}
+
+/* returns the press that the frame being recorded is the first to show
+ * (0 = none); it's handed to LatencyPresented() once that frame is up
+ */
+uint64_t LatencyTakeApplied(struct Flappy *game)
+{
+	struct Latency *latency;
+	uint64_t applied;
+	
+	assert(game);
+	assert(game->latency);
+	
+	latency = game->latency;
+	applied = latency->applied;
+	latency->applied = 0;
+	
+	return applied;
+}
+
+/* a frame showing the press at `applied` has just been presented */
+void LatencyPresented(struct Flappy *game, uint64_t applied)
+{
+	struct Latency *latency;
+	
+	assert(game);
+	assert(game->latency);
+	
+	latency = game->latency;
+	
+	SDL_AtomicLock(&latency->lock);
+	HistogramAdd(&latency->toPresent, LatencyElapsed(latency, applied));
+	SDL_AtomicUnlock(&latency->lock);
+}
+
+/* get copies of the histograms measured so far */
+void LatencyGetHistograms(struct Flappy *game, struct Histogram *toFlap, struct Histogram *toPresent)
+{
+	struct Latency *latency;
+	
+	assert(game);
+	assert(game->latency);
+	
+	latency = game->latency;
+	
+	SDL_AtomicLock(&latency->lock);
+	if (toFlap)
+		*toFlap = latency->toFlap;
+	if (toPresent)
+		*toPresent = latency->toPresent;
+	SDL_AtomicUnlock(&latency->lock);
+}
+
+/* print a summary of what has been measured */
+void LatencyReport(struct Flappy *game, FILE *fp)
+{
+	struct Histogram toFlap;
+	struct Histogram toPresent;
+	
+	assert(game);
+	assert(fp);
+	
+	LatencyGetHistograms(game, &toFlap, &toPresent);
+	
+	if (!toPresent.count)
+		return;
+	
+	fprintf(fp, "input latency (%u flaps): "
+		"to flap p50 %.2fms p99 %.2fms, "
+		"to present p50 %.2fms p99 %.2fms max %.2fms\n"
+		, toPresent.count
+		, HistogramGetPercentile(&toFlap, 50)
+		, HistogramGetPercentile(&toFlap, 99)
+		, HistogramGetPercentile(&toPresent, 50)
+		, HistogramGetPercentile(&toPresent, 99)
+		, toPresent.max
+	);
+}
@@ -12,17 +12,32 @@
  */
 static int loop(struct Flappy *game)
 {
+	PROFILE_BEGIN(game, PROFILE_FRAME);
+	HudFrame(game);
 	FlappyInput(game);
 	
 	/* game exit condition met */
 	if (game->input.quit)
+	{
+		PROFILE_END(game, PROFILE_FRAME);
 		return 0;
+	}
 	
 	/* update game state and entities */
+	HudBegin(game);
 	FlappyUpdate(game);
+	HudEnd(game, HUD_PHASE_SIM);
 	
 	/* draw everything */
+	HudBegin(game);
 	FlappyDraw(game);
+	HudEnd(game, HUD_PHASE_DRAW);
+	
+	/* wait for the next frame */
+	PROFILE_BEGIN(game, PROFILE_WAIT);
+	PacerWait(game);
+	PROFILE_END(game, PROFILE_WAIT);
+	PROFILE_END(game, PROFILE_FRAME);
 	
 	return 1;
 }
@@ -30,11 +45,85 @@ static int loop(struct Flappy *game)
 int main(int argc, char *argv[])
 {
 	struct Flappy *game;
+	unsigned fps = 0;
+	unsigned simRate = 0;
+	int renderThread = 0;
+	const char *capture = 0;
+	const char *captureFormat = "png";
+	const char *script = 0;
+	const char *profile = 0;
+	int profileCounters = 0;
+	int software = 0;
+	const char *trace = 0;
+	int i;
+	
+	/* measure and validate the optimized paths instead of playing */
+	if (argc > 1 && !strcmp(argv[1], "--benchmark"))
+	{
+		int parabolaErrors;
+		int softwareErrors;
+		
+		parabolaErrors = ParabolaBatchBenchmark();
+		softwareErrors = SoftwareValidate();
+		printf("software validation: %s\n", softwareErrors ? "FAILED" : "ok");
+		
+		return (parabolaErrors || softwareErrors) ? -1 : 0;
+	}
+	
+	/* options */
+	for (i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+			fps = strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "--sim-rate") && i + 1 < argc)
+			simRate = strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "--render-thread"))
+			renderThread = 1;
+		else if (!strcmp(argv[i], "--software"))
+			software = 1;
+		else if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+			capture = argv[++i];
+		else if (!strcmp(argv[i], "--capture-format") && i + 1 < argc)
+			captureFormat = argv[++i];
+		else if (!strcmp(argv[i], "--script") && i + 1 < argc)
+			script = argv[++i];
+		else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+			profile = argv[++i];
+		else if (!strcmp(argv[i], "--profile-counters"))
+			profileCounters = 1;
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			trace = argv[++i];
+	}
+	
+	if (profileCounters && !profile)
+		fprintf(stderr, "--profile-counters needs --profile\n");
+	
+#ifndef FLAPPY_PROFILE
+	if (profile || trace)
+	{
+		fprintf(stderr, "--profile and --trace need a build with FLAPPY_PROFILE defined\n");
+		profile = trace = 0;
+	}
+#endif
 	
 	/* initialize gameplay  */
-	if (!(game = FlappyNew()))
+	if (!(game = FlappyNew(trace, software)))
 		return -1;
 	
+	if (fps)
+		PacerSetRate(game, game->pacer, fps);
+	game->simRate = simRate;
+	if (capture && !(game->capture = CaptureNew(game, capture, captureFormat)))
+		FlappyFatal("memory error");
+	if (renderThread)
+		BatchStartThread(game);
+	if (script && !(game->inputSource = InputSourceNew(game, script)))
+		FlappyFatal("memory error");
+#ifdef FLAPPY_PROFILE
+	if (profile && !(game->profile = ProfileNew(game, profile, profileCounters)))
+		FlappyFatal("memory error");
+#endif
+	
 	/* main loop */
 	while (1)
 	{
@@ -18,6 +18,7 @@ struct Obstacle
 	SDL_Rect upper;   /* rectangle of upper sprite */
 	SDL_Rect lower;   /* rectangle of lower sprite */
 	float    x;       /* x position of the obstacle's left edge */
+	float    xPrev;   /* x as of previous simulation step */
 	float    y;       /* y position of the obstacle's center */
 	uint32_t ticks;   /* the time at which this one was spawned */
 	int      expired; /* mark available for reuse */
@@ -58,6 +59,7 @@ void ObstaclePush(struct Flappy *game)
 	ob->lower = ob->upper;
 	ob->expired = 0;
 	ob->ticks = game->ticks;
+	ob->x = ob->xPrev = WINDOW_W + OB_W;
 	ob->cleared = 0;
 	this = FlappyRand(game) % ARRAY_COUNT(yArray);
 	
@@ -144,6 +146,7 @@ void ObstacleUpdateAll(struct Flappy *game)
 		if (ob->expired)
 			continue;
 		
+		ob->xPrev = ob->x;
 		ob->x = WINDOW_W + OB_W;
 		ob->x -= WORLD_SCROLL(game->ticks - ob->ticks);
 		
@@ -190,17 +193,21 @@ void ObstacleDrawAll(struct Flappy *game)
 	for (ob = game->obstacleList; ob; ob = ob->next)
 	{
 		SDL_Rect clip = {game->theme * OB_W, 0, OB_W, OB_H};
+		float x;
 		
 		/* skip any that aren't being used */
 		if (ob->expired)
 			continue;
 		
+		/* between the last two simulation steps */
+		x = LERP(ob->xPrev, ob->x, game->simAlpha);
+		
 		/* display, easy */
-		TextureDraw(game, game->obstacles, clip, ob->x, ob->lower.y);
+		ImageDraw(game, game->obstacles, clip, x, ob->lower.y);
 		
 		/* adjust clipping rectangle and display mirrored version */
 		clip.y += OB_H;
-		TextureDraw(game, game->obstacles, clip, ob->x, ob->upper.y);
+		ImageDraw(game, game->obstacles, clip, x, ob->upper.y);
 	}
 }
 
@@ -218,3 +225,19 @@ void ObstacleCleanup(struct Flappy *game)
 	game->obstacleList = 0;
 }
 
+/* count obstacles in use, and how many have been allocated */
+void ObstacleGetCounts(struct Flappy *game, unsigned *live, unsigned *cap)
+{
+	struct Obstacle *ob;
+	
+	assert(game);
+	assert(live);
+	assert(cap);
+	
+	*live = *cap = 0;
+	for (ob = game->obstacleList; ob; ob = ob->next)
+	{
+		*live += !ob->expired;
+		*cap += 1;
+	}
+}
@@ -0,0 +1,164 @@
+/*
+ * pacer.c <z64.me>
+ *
+ * frame pacing for when vsync isn't there to do it; most
+ * of each frame interval is slept away, and the last bit
+ * is spun through for accuracy
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define PACER_SPIN_MS    2   /* final stretch of each interval spent spinning */
+#define PACER_IDLE_MS    100 /* longest wait when there's nothing to animate */
+#define PACER_RATE       60  /* fallback rate if the display's is unknown */
+
+struct Pacer
+{
+	uint64_t            freq;      /* performance counter frequency */
+	uint64_t            period;    /* counter ticks per frame (0 = unpaced) */
+	uint64_t            deadline;  /* when the next frame is due */
+	unsigned            rate;      /* frames per second (0 = unpaced) */
+};
+
+/* wait for an event to arrive, up to `ms` milliseconds */
+static void PacerIdle(unsigned ms)
+{
+	if (ms)
+		SDL_WaitEventTimeout(0, ms);
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate a frame pacer; it paces at the display's refresh rate
+ * unless the renderer already synchronizes with it
+ */
+struct Pacer *PacerNew(struct Flappy *game)
+{
+	struct Pacer *pacer = calloc(1, sizeof(*pacer));
+	
+	assert(game);
+	
+	if (!pacer)
+		return 0;
+	
+	pacer->freq = SDL_GetPerformanceFrequency();
+	
+	PacerSetRate(game, pacer, 0);
+	
+	return pacer;
+}
+
+void PacerFree(struct Pacer *pacer)
+{
+	assert(pacer);
+	
+	free(pacer);
+}
+
+/* set the target frame rate, or 0 to pick one automatically */
+void PacerSetRate(struct Flappy *game, struct Pacer *pacer, unsigned rate)
+{
+	assert(game);
+	assert(pacer);
+	
+	if (!rate)
+	{
+		SDL_RendererInfo info;
+		SDL_DisplayMode dm;
+		
+		/* vsync is already pacing us */
+		if (!SDL_GetRendererInfo(game->renderer, &info)
+			&& (info.flags & SDL_RENDERER_PRESENTVSYNC)
+		)
+			rate = 0;
+		else if (!SDL_GetWindowDisplayMode(game->window, &dm) && dm.refresh_rate > 0)
+			rate = dm.refresh_rate;
+		else
+			rate = PACER_RATE;
+	}
+	
+	pacer->rate = rate;
+	pacer->period = rate ? pacer->freq / rate : 0;
+	pacer->deadline = 0;
+}
+
+/* returns the frame rate being paced to (0 = unpaced) */
+unsigned PacerGetRate(struct Pacer *pacer)
+{
+	assert(pacer);
+	
+	return pacer->rate;
+}
+
+/* wait until it's time for the next frame; when the game is paused
+ * or minimized it waits for input instead, and on the title screen
+ * it sleeps through the whole interval without spinning
+ */
+void PacerWait(struct Flappy *game)
+{
+	struct Pacer *pacer;
+	uint64_t now;
+	uint64_t remaining;
+	unsigned ms;
+	
+	assert(game);
+	assert(game->pacer);
+	
+	pacer = game->pacer;
+	now = SDL_GetPerformanceCounter();
+	
+	/* nothing is animating; scripted input doesn't arrive as SDL
+	 * events, so it couldn't end the wait, and frames are paced as
+	 * usual while a script is running
+	 */
+	if ((game->windowMinimized || game->paused) && !game->inputSource)
+	{
+		PacerIdle(PACER_IDLE_MS);
+		pacer->deadline = 0;
+		return;
+	}
+	
+	if (!pacer->period)
+		return;
+	
+	/* if a frame ran long, start over rather than rushing to catch up */
+	if (!pacer->deadline || now > pacer->deadline + pacer->period)
+		pacer->deadline = now;
+	pacer->deadline += pacer->period;
+	
+	/* an idle wait that an event cut short would otherwise leave the
+	 * deadline to creep further ahead of real time every frame
+	 */
+	if (pacer->deadline > now + pacer->period)
+		pacer->deadline = now + pacer->period;
+	
+	if (now >= pacer->deadline)
+		return;
+	remaining = pacer->deadline - now;
+	ms = remaining * 1000 / pacer->freq;
+	
+	/* not much happening, so a few milliseconds of jitter are fine */
+	if (game->state == FLAPPY_STATE_TITLE)
+	{
+		PacerIdle(ms);
+		return;
+	}
+	
+	/* sleep most of the interval, then spin the rest */
+	if (ms > PACER_SPIN_MS)
+		SDL_Delay(ms - PACER_SPIN_MS);
+	while (SDL_GetPerformanceCounter() < pacer->deadline)
+		;
+}
@@ -0,0 +1,383 @@
+/*
+ * parabola.c <z64.me>
+ *
+ * player trajectory math, including a batch evaluator
+ * for testing many candidate flaps at once
+ *
+ */
+
+#include "common.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define FIXED_ONE  (1 << PARABOLA_FIXED_SHIFT)
+
+/* convert a float to an IEEE 754 half, rounding to nearest even */
+static uint16_t FloatToHalf(float f)
+{
+	union { float f; uint32_t u; } v = { f };
+	uint32_t sign = (v.u >> 16) & 0x8000;
+	uint32_t mant = v.u & 0x7fffff;
+	int exp = (int)((v.u >> 23) & 0xff);
+	uint32_t half;
+	uint32_t rem;
+	
+	/* infinity and nan */
+	if (exp == 0xff)
+		return sign | 0x7c00 | (mant ? 0x200 : 0);
+	
+	exp += 15 - 127;
+	
+	/* overflow */
+	if (exp >= 31)
+		return sign | 0x7c00;
+	
+	/* subnormal or zero */
+	if (exp <= 0)
+	{
+		int shift = 14 - exp;
+		
+		if (shift > 24)
+			return sign;
+		
+		mant |= 0x800000;
+		half = mant >> shift;
+		rem = mant & ((1u << shift) - 1);
+		if (rem > (1u << (shift - 1)) || (rem == (1u << (shift - 1)) && (half & 1)))
+			++half;
+		
+		return sign | half;
+	}
+	
+	/* normal; a carry out of the mantissa correctly bumps the exponent */
+	half = sign | (exp << 10) | (mant >> 13);
+	rem = mant & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+		++half;
+	
+	return half;
+}
+
+/* convert an IEEE 754 half back to a float (used for validation) */
+static float HalfToFloat(uint16_t h)
+{
+	float mant = h & 0x3ff;
+	int exp = (h >> 10) & 0x1f;
+	float f;
+	
+	if (exp == 0)
+		f = ldexpf(mant, -24);
+	else if (exp == 31)
+		f = mant ? NAN : INFINITY;
+	else
+		f = ldexpf(mant + 1024, exp - 25);
+	
+	return (h & 0x8000) ? -f : f;
+}
+
+/* convert a float to saturated fixed point */
+static int16_t FloatToFixed(float f)
+{
+	f *= FIXED_ONE;
+	
+	if (f >= INT16_MAX)
+		return INT16_MAX;
+	if (f <= INT16_MIN)
+		return INT16_MIN;
+	
+	return lrintf(f);
+}
+
+/* evaluate one parabola at one point in time, without pow() */
+static inline float Evaluate(float y, uint32_t start, uint32_t ticks)
+{
+	float seconds = (int32_t)(ticks - start) * 0.001f;
+	
+	return (PLAYER_GRV * seconds + PLAYER_YVEL) * seconds + y;
+}
+
+/* store `num` floats in the requested format */
+static void Store(void *out, int ofs, const float *y, int num, enum ParabolaFormat format)
+{
+	int i;
+	
+	switch (format)
+	{
+		case PARABOLA_FORMAT_F32:
+			memcpy((float*)out + ofs, y, num * sizeof(*y));
+			break;
+		
+		case PARABOLA_FORMAT_F16:
+			for (i = 0; i < num; ++i)
+				((uint16_t*)out)[ofs + i] = FloatToHalf(y[i]);
+			break;
+		
+		case PARABOLA_FORMAT_FIXED:
+			for (i = 0; i < num; ++i)
+				((int16_t*)out)[ofs + i] = FloatToFixed(y[i]);
+			break;
+		
+		case PARABOLA_FORMAT_MAX:
+			break;
+	}
+}
+
+#ifdef __SSE2__
+/* evaluate one parabola at four points in time, storing them in the requested format */
+static inline void Evaluate4(__m128 y0, __m128i start, const uint32_t *ticks, void *out, int ofs, enum ParabolaFormat format)
+{
+	const __m128 grv = _mm_set1_ps(PLAYER_GRV);
+	const __m128 yvel = _mm_set1_ps(PLAYER_YVEL);
+	const __m128 msec = _mm_set1_ps(0.001f);
+	__m128i along;
+	__m128 seconds;
+	__m128 y;
+	
+	along = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)ticks), start);
+	seconds = _mm_mul_ps(_mm_cvtepi32_ps(along), msec);
+	y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(grv, seconds), yvel), seconds), y0);
+	
+	switch (format)
+	{
+		case PARABOLA_FORMAT_F32:
+			_mm_storeu_ps((float*)out + ofs, y);
+			break;
+		
+		case PARABOLA_FORMAT_F16:
+		{
+		#ifdef __F16C__
+			_mm_storel_epi64((__m128i*)((uint16_t*)out + ofs), _mm_cvtps_ph(y, _MM_FROUND_TO_NEAREST_INT));
+		#else
+			float tmp[4];
+			
+			_mm_storeu_ps(tmp, y);
+			Store(out, ofs, tmp, 4, format);
+		#endif
+			break;
+		}
+		
+		case PARABOLA_FORMAT_FIXED:
+		{
+			/* cvtps rounds to nearest even, packs saturates, like FloatToFixed() */
+			__m128i fixed = _mm_cvtps_epi32(_mm_mul_ps(y, _mm_set1_ps(FIXED_ONE)));
+			
+			_mm_storel_epi64((__m128i*)((int16_t*)out + ofs), _mm_packs_epi32(fixed, fixed));
+			break;
+		}
+		
+		case PARABOLA_FORMAT_MAX:
+			break;
+	}
+}
+#endif /* __SSE2__ */
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* player movement is accomplished using a simple quadratic equation;
+ * this solution keeps the game framerate-independent without having
+ * to introduce frame step logic
+ * https://www.slideshare.net/snewgas/applications-of-the-vertex-formula-edit-8191421
+ */
+float ParabolaMotion(struct Parabola p, uint32_t milliseconds)
+{
+	float seconds;
+	
+	seconds = milliseconds * 0.001f;
+	
+	return PLAYER_GRV * pow(seconds, 2) + PLAYER_YVEL * seconds + p.y;
+}
+
+/* evaluate every parabola at every game time in `ticks`;
+ * results are written row by row (one row of `ticksNum` samples per
+ * parabola) into `out`, which is an array of float, uint16_t (half) or
+ * int16_t (fixed) depending on `format`; times earlier than a parabola's
+ * start are extrapolated backwards
+ */
+void ParabolaBatch(const struct Parabola *parabola, int parabolaNum, const uint32_t *ticks, int ticksNum, void *out, enum ParabolaFormat format)
+{
+	int p;
+	
+	assert(parabola || !parabolaNum);
+	assert(ticks || !ticksNum);
+	assert(out || !parabolaNum || !ticksNum);
+	assert(format < PARABOLA_FORMAT_MAX);
+	
+	for (p = 0; p < parabolaNum; ++p)
+	{
+		const float y0 = parabola[p].y;
+		const uint32_t start = parabola[p].ticks;
+		int ofs = p * ticksNum;
+		int i = 0;
+	
+	#ifdef __SSE2__
+		{
+			const __m128 y0v = _mm_set1_ps(y0);
+			const __m128i startv = _mm_set1_epi32(start);
+			
+			for ( ; i + 4 <= ticksNum; i += 4)
+				Evaluate4(y0v, startv, ticks + i, out, ofs + i, format);
+		}
+	#endif
+		
+		/* remaining samples (or all of them, without SIMD) */
+		for ( ; i < ticksNum; ++i)
+		{
+			float y = Evaluate(y0, start, ticks[i]);
+			
+			Store(out, ofs + i, &y, 1, format);
+		}
+	}
+}
+
+/* compare ParabolaBatch() against ParabolaMotion() in every format;
+ * returns the number of samples that fall outside tolerance
+ */
+int ParabolaBatchValidate(void)
+{
+	struct Parabola parabola[33];
+	uint32_t ticks[101];
+	static float outF32[ARRAY_COUNT(parabola) * ARRAY_COUNT(ticks)];
+	static uint16_t outF16[ARRAY_COUNT(outF32)];
+	static int16_t outFixed[ARRAY_COUNT(outF32)];
+	int errors = 0;
+	int p;
+	int i;
+	
+	/* awkward (non-multiple of four) counts exercise the scalar tail;
+	 * samples stay within three seconds so fixed point doesn't saturate
+	 */
+	for (p = 0; p < (int)ARRAY_COUNT(parabola); ++p)
+		parabola[p] = (struct Parabola){ .y = (p * 37) % WINDOW_H - 8.5f, .ticks = 100000 + p * 29 };
+	for (i = 0; i < (int)ARRAY_COUNT(ticks); ++i)
+		ticks[i] = 101000 + i * 17;
+	
+	ParabolaBatch(parabola, ARRAY_COUNT(parabola), ticks, ARRAY_COUNT(ticks), outF32, PARABOLA_FORMAT_F32);
+	ParabolaBatch(parabola, ARRAY_COUNT(parabola), ticks, ARRAY_COUNT(ticks), outF16, PARABOLA_FORMAT_F16);
+	ParabolaBatch(parabola, ARRAY_COUNT(parabola), ticks, ARRAY_COUNT(ticks), outFixed, PARABOLA_FORMAT_FIXED);
+	
+	for (p = 0; p < (int)ARRAY_COUNT(parabola); ++p)
+	{
+		for (i = 0; i < (int)ARRAY_COUNT(ticks); ++i)
+		{
+			int n = p * ARRAY_COUNT(ticks) + i;
+			float ref = ParabolaMotion(parabola[p], ticks[i] - parabola[p].ticks);
+			float f32 = outF32[n];
+			float f16 = HalfToFloat(outF16[n]);
+			float fixed = (float)outFixed[n] / FIXED_ONE;
+			
+			/* tolerances are a few ulps of each format */
+			if (fabsf(f32 - ref) > 1e-3f + fabsf(ref) * 1e-5f
+				|| fabsf(f16 - ref) > 1e-3f + fabsf(ref) * (1.0f / 1024)
+				|| fabsf(fixed - ref) > 1e-3f + 0.5f / FIXED_ONE
+			)
+			{
+				if (!errors)
+					fprintf(stderr, "parabola %d tick %u: expected %f, got %f (f32) %f (f16) %f (fixed)\n"
+						, p, ticks[i], ref, f32, f16, fixed
+					);
+				++errors;
+			}
+		}
+	}
+	
+	return errors;
+}
+
+/* validate and measure ParabolaBatch() throughput, printing results
+ * to stdout; returns the number of validation errors
+ */
+int ParabolaBatchBenchmark(void)
+{
+	const char *formatName[] = {
+		[PARABOLA_FORMAT_F32] = "f32"
+		, [PARABOLA_FORMAT_F16] = "f16"
+		, [PARABOLA_FORMAT_FIXED] = "fixed"
+	};
+	struct Parabola *parabola;
+	uint32_t *ticks;
+	void *out;
+	const int parabolaNum = 1024;
+	const int ticksNum = 1024;
+	const double samples = (double)parabolaNum * ticksNum;
+	const double freq = SDL_GetPerformanceFrequency();
+	volatile float sink = 0;
+	uint64_t start;
+	double elapsed;
+	int errors;
+	int reps;
+	int p;
+	int i;
+	
+	parabola = malloc(parabolaNum * sizeof(*parabola));
+	ticks = malloc(ticksNum * sizeof(*ticks));
+	out = malloc(samples * sizeof(float)); /* the widest format */
+	if (!parabola || !ticks || !out)
+		FlappyFatal("memory error");
+	
+	/* one candidate flap per millisecond, sampled every frame for ~17 seconds */
+	for (p = 0; p < parabolaNum; ++p)
+		parabola[p] = (struct Parabola){ .y = WINDOW_H / 2, .ticks = p };
+	for (i = 0; i < ticksNum; ++i)
+		ticks[i] = parabolaNum + i * 16;
+	
+	errors = ParabolaBatchValidate();
+	printf("parabola validation: %s\n", errors ? "FAILED" : "ok");
+	
+	/* reference implementation */
+	start = SDL_GetPerformanceCounter();
+	for (p = 0; p < parabolaNum; ++p)
+		for (i = 0; i < ticksNum; ++i)
+			sink += ParabolaMotion(parabola[p], ticks[i] - parabola[p].ticks);
+	elapsed = (SDL_GetPerformanceCounter() - start) / freq;
+	printf("ParabolaMotion:       %8.2f Msamples/s\n", samples / elapsed / 1e6);
+	
+	/* batches, repeated until a quarter of a second has passed */
+	for (i = 0; i < PARABOLA_FORMAT_MAX; ++i)
+	{
+		start = SDL_GetPerformanceCounter();
+		for (reps = 0, elapsed = 0; elapsed < 0.25; ++reps)
+		{
+			ParabolaBatch(parabola, parabolaNum, ticks, ticksNum, out, i);
+			switch (i)
+			{
+				case PARABOLA_FORMAT_F32:
+					sink += ((float *)out)[reps % ticksNum];
+					break;
+				
+				case PARABOLA_FORMAT_F16:
+					sink += ((uint16_t *)out)[reps % ticksNum];
+					break;
+				
+				case PARABOLA_FORMAT_FIXED:
+					sink += ((int16_t *)out)[reps % ticksNum];
+					break;
+			}
+			elapsed = (SDL_GetPerformanceCounter() - start) / freq;
+		}
+		printf("ParabolaBatch (%-5s): %8.2f Msamples/s\n", formatName[i], samples * reps / elapsed / 1e6);
+	}
+	
+	free(parabola);
+	free(ticks);
+	free(out);
+	
+	(void)sink;
+	
+	return errors;
+}
@@ -109,7 +109,7 @@ void ParticleDrawAll(struct Flappy *game)
 	{
 		const struct Frame *f;
 		SDL_Rect clip;
-		uint32_t ticks = game->ticks - p->ticks;
+		uint32_t ticks = FlappyGetDrawTicks(game, p->ticks);
 		uint32_t walk = 0;
 		float x = p->x - WIDTH / 2 - WORLD_SCROLL(ticks);
 		float y = p->y - HEIGHT / 2;
@@ -136,7 +136,7 @@ void ParticleDrawAll(struct Flappy *game)
 		
 		/* derive clipping rectangle and display onto screen */
 		clip = (SDL_Rect){f->col * WIDTH, f->row * HEIGHT, WIDTH, HEIGHT};
-		TextureDraw(game, game->particles, clip, x, y);
+		ImageDraw(game, game->particles, clip, x, y);
 	}
 }
 
@@ -155,3 +155,19 @@ void ParticleCleanup(struct Flappy *game)
 	game->particleList = 0;
 }
 
+/* count particles in use, and how many have been allocated */
+void ParticleGetCounts(struct Flappy *game, unsigned *live, unsigned *cap)
+{
+	struct Particle *p;
+	
+	assert(game);
+	assert(live);
+	assert(cap);
+	
+	*live = *cap = 0;
+	for (p = game->particleList; p; p = p->next)
+	{
+		*live += !p->expired;
+		*cap += 1;
+	}
+}
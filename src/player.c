@@ -13,8 +13,15 @@
  *
  ******************************/
 
+#ifndef GHOST_MAX
 #define GHOST_MAX    64     /* for deriving earlier player positions */
+#endif
 #define GHOST_SPEED  20000  /* milliseconds for ghost to catch up */
+#define GHOST_DEBUG_RES  4  /* ghost trail samples per pixel */
+
+#if GHOST_MAX < 1
+#error "GHOST_MAX must be at least 1"
+#endif
 
 enum FairyType
 {
@@ -32,36 +39,37 @@ struct FairySprite
 	uint32_t            particleTime;      /* time last particle was spawned */
 };
 
-/* quadratic equation parameters */
-struct Parabola
-{
-	float               y;                 /* initial y position */
-	uint32_t            ticks;             /* initial time */
-};
-
 struct Player
 {
 	float               x;                 /* position */
 	float               y;
-	struct Parabola     ghost[GHOST_MAX];  /* earlier player parabolas */
+	float               yPrev;             /* y as of previous simulation step */
+	uint32_t            ticksPrev;         /* game->ticks as of previous simulation step */
+	struct Parabola     ghost[GHOST_MAX];  /* earlier player parabolas (ring buffer) */
+	unsigned            ghostHead;         /* index of newest ghost in ring */
+	unsigned            ghostNum;          /* number of ghosts stored in ring */
 	struct FairySprite  sprite[FAIRY_MAX]; /* Navi's friends */
 	struct Parabola     parabola;          /* player position calculations */
-	int                 mouseUp;           /* mouse state tracking */
 	int                 isDead;            /* boolean player is dead */
 };
 
-/* player movement is accomplished using a simple quadratic equation;
- * this solution keeps the game framerate-independent without having
- * to introduce frame step logic
- * https://www.slideshare.net/snewgas/applications-of-the-vertex-formula-edit-8191421
+/* returns the game time the mouse was pressed, no earlier than
+ * `ticksPrev` (the previous step) and no later than the current step
  */
-static float ParabolaMotion(struct Parabola p, uint32_t milliseconds)
+static uint32_t PlayerGetClickTicks(struct Flappy *game, uint32_t ticksPrev)
 {
-	float seconds;
+	double ticks;
+	
+	assert(game);
 	
-	seconds = milliseconds * 0.001f;
+	ticks = TimerGetTimeAt(game->timer, game->input.clickStamp);
 	
-	return PLAYER_GRV * pow(seconds, 2) + PLAYER_YVEL * seconds + p.y;
+	if (ticks > game->ticks || ticksPrev > game->ticks)
+		return game->ticks;
+	if (ticks < ticksPrev)
+		return ticksPrev;
+	
+	return ticks;
 }
 
 /* linearly interpolate from `hi` to `lo` across `total` milliseconds */
@@ -109,7 +117,7 @@ static void DrawPlayerSprite(struct Flappy *game, struct FairySprite *fairy, uin
 	/* hovering in place */
 	if (!game->playerflapped)
 	{
-		sprite = game->ticks / 150;
+		sprite = FlappyGetDrawTicks(game, 0) / 150;
 		sprite %= 3;
 		
 		/* shift the sprite down a little on this frame */
@@ -143,11 +151,49 @@ static void DrawPlayerSprite(struct Flappy *game, struct FairySprite *fairy, uin
 	}
 }
 
+/* get a ghost by age (0 = newest flap, 1 = the one before it, etc) */
+static struct Parabola *GhostAt(struct Player *player, unsigned age)
+{
+	assert(player);
+	assert(age < player->ghostNum);
+	
+	return &player->ghost[(player->ghostHead + GHOST_MAX - age) % GHOST_MAX];
+}
+
+/* find the parabola that was active at time `when`; because flaps are
+ * pushed in order, ghost ticks are monotonic, so a binary search over
+ * ages yields the newest ghost that started at or before `when`
+ */
+static struct Parabola *GhostFind(struct Player *player, uint32_t when)
+{
+	unsigned lo = 0;
+	unsigned hi;
+	
+	assert(player);
+	
+	hi = player->ghostNum;
+	
+	while (lo < hi)
+	{
+		unsigned mid = lo + (hi - lo) / 2;
+		
+		if (GhostAt(player, mid)->ticks <= when)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	
+	/* no ghost found (it predates the oldest stored flap) */
+	if (lo == player->ghostNum)
+		return 0;
+	
+	return GhostAt(player, lo);
+}
+
 /* get earlier player y position and time since flap */
 static float GhostY(struct Flappy *game, struct Player *player, float x, uint32_t *since)
 {
 	struct Parabola *p;
-	struct Parabola *ghostEnd;
 	uint32_t ago;
 	uint32_t when;
 	uint32_t along;
@@ -162,26 +208,10 @@ static float GhostY(struct Flappy *game, struct Player *player, float x, uint32_
 	/* calculate how many milliseconds ago player was at x position */
 	ago = ((player->x - x) / SCROLL_SPEED) * 1000;
 	
-	/* last ghost in list */
-	ghostEnd = player->ghost + GHOST_MAX;
-	
-	when = game->ticks - ago;
-	
-	/* special case: it could be in the first parabola */
-	p = player->ghost;
-	if (when < p->ticks)
-	{
-		/* it isn't, so now test each */
-		for (p = player->ghost + 1; p != ghostEnd; ++p)
-		{
-			/* in parabola window */
-			if (when >= (p)->ticks && when < (p-1)->ticks)
-				break;
-		}
-	}
+	when = FlappyGetDrawTicks(game, 0) - ago;
 	
 	/* no ghost found; return off-screen position */
-	if (p == ghostEnd || !p->ticks)
+	if (!(p = GhostFind(player, when)))
 		return WINDOW_H * 2;
 	
 	/* time since flap */
@@ -195,35 +225,63 @@ static float GhostY(struct Flappy *game, struct Player *player, float x, uint32_
 /* display all earlier player positions */
 static void GhostDebug(struct Flappy *game, struct Player *player)
 {
-	float x;
+	static SDL_Rect rects[(WINDOW_W + 32) * GHOST_DEBUG_RES + 1];
+	static SDL_Color colors[ARRAY_COUNT(rects)];
+	unsigned age = 0;
 	int thickness = 3;
+	int num = 0;
+	int i;
 	
-	for (x = player->x; x >= -32; x -= 0.25f)
+	assert(game);
+	assert(player);
+	
+	for (i = 0; num < (int)ARRAY_COUNT(rects); ++i)
 	{
+		struct Parabola *p;
+		float x = player->x - (float)i / GHOST_DEBUG_RES;
 		float xP;
 		float yP;
 		float h, s, v;
-		SDL_Rect rect;
-		uint8_t r, g, b;
+		SDL_Rect *rect = &rects[num];
+		SDL_Color *color = &colors[num];
+		uint32_t when;
+		
+		if (x < -32)
+			break;
+		
+		/* the trail walks backwards in time, so rather than searching
+		 * for each sample's parabola, step back through older ones
+		 */
+		when = FlappyGetDrawTicks(game, 0) - (uint32_t)(((player->x - x) / SCROLL_SPEED) * 1000);
+		while (age < player->ghostNum && GhostAt(player, age)->ticks > when)
+			++age;
 		
+		/* everything beyond the oldest ghost is off-screen */
+		if (age == player->ghostNum)
+			break;
+		
+		p = GhostAt(player, age);
 		xP = x;
-		yP = GhostY(game, player, x, 0);
+		yP = ParabolaMotion(*p, when - p->ticks);
 		ConvertCenter(&xP, &yP);
-		rect.x = xP * game->scale;
-		rect.y = yP * game->scale;
-		rect.w = thickness * game->scale;
-		rect.h = thickness * game->scale;
-		rect.x -= rect.w / 2;
-		rect.y -= rect.h / 2;
+		rect->x = xP;
+		rect->y = yP;
+		rect->w = thickness;
+		rect->h = thickness;
+		rect->x -= rect->w / 2;
+		rect->y -= rect->h / 2;
 		
 		h = fabs(fmod(WORLD_SCROLL(x * 50) / WINDOW_W, 1.0));
 		s = 1;
 		v = 1;
-		HsvToRgb8(h, s, v, &r, &g, &b);
-		SDL_SetRenderDrawColor(game->renderer, r, g, b, -1);
+		HsvToRgb8(h, s, v, &color->r, &color->g, &color->b);
+		color->a = -1;
 		
-		PrimitiveRect(game, rect);
+		++num;
 	}
+	
+	/* submit the whole trail at once */
+	PrimitiveRectsColored(game, rects, colors, num);
 }
 
 /* draw a ghost fairy at earlier player position `x` */
@@ -242,16 +300,14 @@ static void Ghost(struct Flappy *game, struct Player *player, struct FairySprite
 
 static void GhostPush(struct Player *player, struct Parabola parabola)
 {
-	struct Parabola *p;
-	
 	assert(player);
 	
-	/* shift every array element along */
-	for (p = &player->ghost[GHOST_MAX - 1]; p > player->ghost; --p)
-		*p = *(p-1);
+	/* advance head of ring, overwriting the oldest ghost once full */
+	player->ghostHead = (player->ghostHead + 1) % GHOST_MAX;
+	player->ghost[player->ghostHead] = parabola;
 	
-	/* new value at head of array */
-	*p = parabola;
+	if (player->ghostNum < GHOST_MAX)
+		player->ghostNum += 1;
 }
 
 
@@ -294,6 +350,7 @@ void PlayerSetPos(struct Player *player, float x, float y)
 	
 	player->x = x;
 	player->y = y;
+	player->yPrev = y;
 }
 
 
@@ -338,9 +395,15 @@ void PlayerFree(struct Player *player)
 void PlayerUpdate(struct Flappy *game, struct Player *player)
 {
 	
+	uint32_t ticksPrev;
+	
 	assert(game);
 	assert(player);
 	
+	player->yPrev = player->y;
+	ticksPrev = player->ticksPrev;
+	player->ticksPrev = game->ticks;
+	
 	if (player->isDead)
 		return;
 	
@@ -352,23 +415,30 @@ void PlayerUpdate(struct Flappy *game, struct Player *player)
 		player->y = ParabolaMotion(player->parabola, game->ticks - player->parabola.ticks);
 	
 	/* mouse click = flap your wings */
-	if (!game->buttonhover && player->mouseUp && game->input.mouseDown)
+	if (!UiIsHovering(game) && game->input.pressed)
 	{
+		uint32_t ticks = PlayerGetClickTicks(game, ticksPrev);
+		float y = player->y;
+		
 		/* initial flap */
 		if (!game->playerflapped)
 		{
-			memset(player->ghost, 0, sizeof(player->ghost));
+			player->ghostNum = 0;
 			game->playerflapped = 1;
 		}
+		else
+			y = ParabolaMotion(player->parabola, ticks - player->parabola.ticks);
+		
+		/* set up current flap, starting when the click happened */
+		player->parabola.ticks = ticks;
+		player->parabola.y = y;
+		player->y = ParabolaMotion(player->parabola, game->ticks - ticks);
 		
-		/* set up current flap */
-		player->parabola.ticks = game->ticks;
-		player->parabola.y = player->y;
+		LatencyFlap(game);
 		
 		/* store new flap as ghost flap */
 		GhostPush(player, player->parabola);
 	}
-	player->mouseUp = !game->input.mouseDown;
 	
 	/* collider */
 	ColliderArenaPush(game, player, OnTouchWorld, COLOR_PLAYER, ColliderInitRect(game, player->x + 4, player->y + 4, 8, 4));
@@ -385,7 +455,7 @@ void PlayerDraw(struct Flappy *game, struct Player *player)
 	/* player is in motion: draw ghosts */
 	if (game->playerflapped)
 	{
-		uint32_t ticks = fmin(game->themeTicks, game->stateTicks);
+		uint32_t ticks = fmin(FlappyGetDrawTicks(game, game->themeStartTime), FlappyGetDrawTicks(game, game->stateStartTime));
 		float fairy1 = creep(-50, 50, GHOST_SPEED, ticks);
 		float fairy2 = creep(-75, 25, GHOST_SPEED, ticks);
 		
@@ -404,6 +474,7 @@ void PlayerDraw(struct Flappy *game, struct Player *player)
 		}
 	}
 	
-	DrawPlayerSprite(game, &player->sprite[FAIRY_NAVI], game->ticks - player->parabola.ticks, player->x, player->y);
+	/* between the last two simulation steps */
+	DrawPlayerSprite(game, &player->sprite[FAIRY_NAVI], FlappyGetDrawTicks(game, player->parabola.ticks), player->x, LERP(player->yPrev, player->y, game->simAlpha));
 }
 
@@ -11,13 +11,37 @@ void PrimitiveRect(struct Flappy *game, SDL_Rect r)
 {
 	assert(game);
 	
-	SDL_RenderFillRect(game->renderer, &r);
+	BatchRect(game, r);
 }
 
 void PrimitiveRectOutline(struct Flappy *game, SDL_Rect r)
 {
 	assert(game);
 	
-	SDL_RenderDrawRect(game->renderer, &r);
+	/* top, bottom, left, right */
+	BatchRect(game, (SDL_Rect){r.x, r.y, r.w, 1});
+	BatchRect(game, (SDL_Rect){r.x, r.y + r.h - 1, r.w, 1});
+	BatchRect(game, (SDL_Rect){r.x, r.y + 1, 1, r.h - 2});
+	BatchRect(game, (SDL_Rect){r.x + r.w - 1, r.y + 1, 1, r.h - 2});
 }
 
+/* display many solid rectangles, each with its own color */
+void PrimitiveRectsColored(struct Flappy *game, const SDL_Rect *rects, const SDL_Color *colors, int num)
+{
+	SDL_Color old;
+	int i;
+	
+	assert(game);
+	assert(rects || !num);
+	assert(colors || !num);
+	
+	old = BatchGetColor(game);
+	
+	for (i = 0; i < num; ++i)
+	{
+		BatchSetColor(game, colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+		BatchRect(game, rects[i]);
+	}
+	
+	BatchSetColor(game, old.r, old.g, old.b, old.a);
+}
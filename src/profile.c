@@ -0,0 +1,358 @@
+/*
+ * profile.c <z64.me>
+ *
+ * frame profiler: zones around each phase of a frame are
+ * timed with the performance counter and accumulated into
+ * histograms, which are saved as json on exit; each zone
+ * is also a slice in the timeline trace, if one's running
+ *
+ * on linux, hardware counters can also be read at each zone
+ * boundary with perf_event_open(), for instructions per cycle
+ * and cache and branch misses per thousand instructions; they
+ * only count the game thread, and where they can't be opened
+ * (containers, virtual machines, perf_event_paranoid) only the
+ * times are recorded; a zone's own reads aren't timed, but the
+ * reads made by zones nested inside it are, so with counters on,
+ * "frame" includes the cost of the instrumentation within it
+ *
+ * it only exists in builds with FLAPPY_PROFILE defined;
+ * otherwise, PROFILE_BEGIN() and PROFILE_END() compile
+ * to nothing
+ *
+ */
+
+#include "common.h"
+
+#ifdef FLAPPY_PROFILE
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#endif /* __linux__ */
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define PROFILE_RESOLUTION  0.001 /* smallest histogram bucket, in milliseconds */
+
+enum ProfileCounter
+{
+	PROFILE_CYCLES
+	, PROFILE_INSTRUCTIONS
+	, PROFILE_CACHE_MISSES
+	, PROFILE_BRANCH_MISSES
+	, PROFILE_COUNTER_MAX
+};
+
+struct Profile
+{
+	const char         *path;      /* where results are saved */
+	uint64_t            freq;      /* performance counter frequency */
+	uint64_t            start[PROFILE_ZONE_MAX]; /* when each open zone began */
+	struct Histogram    zone[PROFILE_ZONE_MAX];
+	int                 counterFd[PROFILE_COUNTER_MAX]; /* -1 = unavailable */
+	int                 counterSlot[PROFILE_COUNTER_MAX]; /* position in a group read */
+	int                 counterNum; /* counters opened (0 = timing only) */
+	int                 counterGroup; /* counter that reads the whole group */
+	uint64_t            counterStart[PROFILE_ZONE_MAX][PROFILE_COUNTER_MAX];
+	uint64_t            counterSum[PROFILE_ZONE_MAX][PROFILE_COUNTER_MAX];
+	int                 counterValid[PROFILE_ZONE_MAX]; /* counterStart was read */
+};
+
+static const char *ProfileZoneName[PROFILE_ZONE_MAX] = {
+	[PROFILE_FRAME] = "frame"
+	, [PROFILE_INPUT] = "input"
+	, [PROFILE_UPDATE_TIMER] = "update.timer"
+	, [PROFILE_UPDATE_COLLIDERS] = "update.colliders"
+	, [PROFILE_UPDATE_HAZARDS] = "update.hazards"
+	, [PROFILE_UPDATE_OBSTACLES] = "update.obstacles"
+	, [PROFILE_UPDATE_PLAYER] = "update.player"
+	, [PROFILE_UPDATE_ARENA] = "update.arena"
+	, [PROFILE_DRAW_WORLD] = "draw.world"
+	, [PROFILE_DRAW_UI] = "draw.ui"
+	, [PROFILE_DRAW_PRESENT] = "draw.present"
+	, [PROFILE_WAIT] = "wait"
+};
+
+static const char *ProfileCounterName[PROFILE_COUNTER_MAX] = {
+	[PROFILE_CYCLES] = "cycles"
+	, [PROFILE_INSTRUCTIONS] = "instructions"
+	, [PROFILE_CACHE_MISSES] = "cacheMisses"
+	, [PROFILE_BRANCH_MISSES] = "branchMisses"
+};
+
+/* open whichever hardware counters are available, as one group so
+ * they're always scheduled together, which keeps ratios between them
+ * meaningful even when the kernel has to multiplex them
+ */
+static void ProfileOpenCounters(struct Profile *profile)
+{
+#ifdef __linux__
+	static const uint64_t config[PROFILE_COUNTER_MAX] = {
+		[PROFILE_CYCLES] = PERF_COUNT_HW_CPU_CYCLES
+		, [PROFILE_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS
+		, [PROFILE_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES
+		, [PROFILE_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES
+	};
+	int i;
+	
+	assert(profile);
+	
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+	{
+		struct perf_event_attr attr;
+		int fd;
+		
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.disabled = !profile->counterNum; /* the group starts all at once */
+		attr.exclude_kernel = 1; /* allowed at the default perf_event_paranoid */
+		attr.exclude_hv = 1;
+		
+		/* this thread, on any cpu */
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1
+			, profile->counterNum ? profile->counterGroup : -1, 0
+		);
+		if (fd < 0)
+		{
+			fprintf(stderr, "profile: no %s counter (%s)\n", ProfileCounterName[i], strerror(errno));
+			continue;
+		}
+		
+		if (!profile->counterNum)
+			profile->counterGroup = fd;
+		profile->counterFd[i] = fd;
+		profile->counterSlot[i] = profile->counterNum++;
+	}
+	
+	if (!profile->counterNum)
+	{
+		fprintf(stderr, "profile: hardware counters unavailable, recording times only\n");
+		return;
+	}
+	
+	ioctl(profile->counterGroup, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(profile->counterGroup, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+	(void)profile;
+	fprintf(stderr, "profile: hardware counters are only supported on linux\n");
+#endif
+}
+
+/* close the hardware counters */
+static void ProfileCloseCounters(struct Profile *profile)
+{
+#ifdef __linux__
+	int i;
+	
+	assert(profile);
+	
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+		if (profile->counterFd[i] >= 0)
+			close(profile->counterFd[i]);
+#else
+	(void)profile;
+#endif
+}
+
+/* read every hardware counter into `value`; returns 0 on failure */
+static int ProfileReadCounters(struct Profile *profile, uint64_t *value)
+{
+#ifdef __linux__
+	uint64_t group[1 + PROFILE_COUNTER_MAX]; /* count, then values */
+	ssize_t want;
+	int i;
+	
+	assert(profile);
+	assert(value);
+	
+	want = (1 + profile->counterNum) * sizeof(*group);
+	if (read(profile->counterGroup, group, sizeof(group)) != want)
+		return 0;
+	
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+		value[i] = profile->counterFd[i] >= 0 ? group[1 + profile->counterSlot[i]] : 0;
+	
+	return 1;
+#else
+	(void)profile;
+	(void)value;
+	
+	return 0;
+#endif
+}
+
+/* write the ratio of two counters, times `scale`, as json (null if it can't be known) */
+static void ProfileWriteRatio(FILE *fp, const char *name, struct Profile *profile, int zone, enum ProfileCounter num, enum ProfileCounter den, double scale)
+{
+	const uint64_t *sum;
+	
+	assert(fp);
+	assert(profile);
+	
+	sum = profile->counterSum[zone];
+	
+	if (profile->counterFd[num] < 0 || profile->counterFd[den] < 0 || !sum[den])
+		fprintf(fp, ", \"%s\": null", name);
+	else
+		fprintf(fp, ", \"%s\": %.4f", name, (double)sum[num] * scale / sum[den]);
+}
+
+/* write results as json */
+static void ProfileWrite(struct Profile *profile, FILE *fp)
+{
+	int i;
+	
+	assert(profile);
+	assert(fp);
+	
+	fprintf(fp, "{\n\t\"units\": \"ms\",\n\t\"counters\": %s,\n\t\"zones\": [\n"
+		, profile->counterNum ? "true" : "false"
+	);
+	for (i = 0; i < PROFILE_ZONE_MAX; ++i)
+	{
+		const struct Histogram *hist = &profile->zone[i];
+		int k;
+		
+		fprintf(fp, "\t\t{ \"name\": \"%s\", \"count\": %u, \"mean\": %.4f"
+			", \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f"
+			, ProfileZoneName[i]
+			, hist->count
+			, hist->count ? hist->sum / hist->count : 0
+			, HistogramGetPercentile(hist, 50)
+			, HistogramGetPercentile(hist, 95)
+			, HistogramGetPercentile(hist, 99)
+			, hist->max
+		);
+		
+		/* totals, then instructions per cycle and misses per thousand instructions */
+		if (profile->counterNum)
+		{
+			for (k = 0; k < PROFILE_COUNTER_MAX; ++k)
+			{
+				if (profile->counterFd[k] < 0)
+					fprintf(fp, ", \"%s\": null", ProfileCounterName[k]);
+				else
+					fprintf(fp, ", \"%s\": %llu", ProfileCounterName[k]
+						, (unsigned long long)profile->counterSum[i][k]
+					);
+			}
+			ProfileWriteRatio(fp, "ipc", profile, i, PROFILE_INSTRUCTIONS, PROFILE_CYCLES, 1);
+			ProfileWriteRatio(fp, "cacheMpki", profile, i, PROFILE_CACHE_MISSES, PROFILE_INSTRUCTIONS, 1000);
+			ProfileWriteRatio(fp, "branchMpki", profile, i, PROFILE_BRANCH_MISSES, PROFILE_INSTRUCTIONS, 1000);
+		}
+		
+		fprintf(fp, " }%s\n", i + 1 < PROFILE_ZONE_MAX ? "," : "");
+	}
+	fprintf(fp, "\t]\n}\n");
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate a profiler, which saves its results to `path` when freed;
+ * if `counters` isn't 0, hardware counters are read as well
+ */
+struct Profile *ProfileNew(struct Flappy *game, const char *path, int counters)
+{
+	struct Profile *profile = calloc(1, sizeof(*profile));
+	int i;
+	
+	assert(game);
+	assert(path);
+	
+	if (!profile)
+		return 0;
+	
+	profile->path = path;
+	profile->freq = SDL_GetPerformanceFrequency();
+	for (i = 0; i < PROFILE_ZONE_MAX; ++i)
+		HistogramInit(&profile->zone[i], PROFILE_RESOLUTION);
+	
+	for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+		profile->counterFd[i] = -1;
+	if (counters)
+		ProfileOpenCounters(profile);
+	
+	return profile;
+}
+
+/* save results and deallocate a profiler */
+void ProfileFree(struct Profile *profile)
+{
+	FILE *fp;
+	
+	assert(profile);
+	
+	if (!(fp = fopen(profile->path, "w")))
+		fprintf(stderr, "failed to open '%s' for writing\n", profile->path);
+	else
+	{
+		ProfileWrite(profile, fp);
+		if (fclose(fp))
+			fprintf(stderr, "failed to write '%s'\n", profile->path);
+	}
+	
+	ProfileCloseCounters(profile);
+	free(profile);
+}
+
+/* start timing a zone */
+void ProfileBegin(struct Flappy *game, enum ProfileZone zone)
+{
+	struct Profile *profile;
+	
+	assert(game);
+	assert(zone < PROFILE_ZONE_MAX);
+	
+	TracePush(game, 'B', "phase", ProfileZoneName[zone], 0);
+	
+	if (!(profile = game->profile))
+		return;
+	
+	/* counters first, so reading them isn't timed */
+	profile->counterValid[zone] = profile->counterNum
+		&& ProfileReadCounters(profile, profile->counterStart[zone]);
+	profile->start[zone] = SDL_GetPerformanceCounter();
+}
+
+/* finish timing a zone */
+void ProfileEnd(struct Flappy *game, enum ProfileZone zone)
+{
+	struct Profile *profile;
+	
+	assert(game);
+	assert(zone < PROFILE_ZONE_MAX);
+	
+	if ((profile = game->profile))
+	{
+		uint64_t now[PROFILE_COUNTER_MAX];
+		int i;
+		
+		HistogramAdd(&profile->zone[zone]
+			, (double)(SDL_GetPerformanceCounter() - profile->start[zone]) * 1000 / profile->freq
+		);
+		
+		/* a zone whose start couldn't be read has nothing to compare against */
+		if (profile->counterValid[zone] && ProfileReadCounters(profile, now))
+			for (i = 0; i < PROFILE_COUNTER_MAX; ++i)
+				profile->counterSum[zone][i] += now[i] - profile->counterStart[zone][i];
+	}
+	
+	TracePush(game, 'E', "phase", ProfileZoneName[zone], 0);
+}
+
+#endif /* FLAPPY_PROFILE */
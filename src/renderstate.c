@@ -0,0 +1,256 @@
+/*
+ * renderstate.c <z64.me>
+ *
+ * a thin layer between the game and the SDL renderer that
+ * remembers the state it last set, so redundant state
+ * changes never reach SDL
+ *
+ */
+
+#include "common.h"
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define TEXTURE_MAX  8 /* number of textures whose state is tracked */
+
+struct TextureState
+{
+	SDL_Texture        *tex;          /* texture being tracked (0 = unused) */
+	SDL_Color           mod;          /* color and alpha mod */
+	SDL_BlendMode       blend;        /* blend mode */
+	unsigned            modKnown:1;   /* color mod has been set */
+	unsigned            alphaKnown:1; /* alpha mod has been set */
+	unsigned            blendKnown:1; /* blend mode has been set */
+};
+
+struct RenderState
+{
+	SDL_Renderer       *renderer;
+	SDL_Texture        *target;       /* render target */
+	SDL_BlendMode       blend;        /* draw blend mode */
+	unsigned            targetKnown:1;
+	unsigned            blendKnown:1;
+	struct TextureState texture[TEXTURE_MAX];
+	unsigned            changes;      /* state changes passed along to SDL */
+	unsigned            elided;       /* redundant state changes skipped */
+};
+
+/* get the tracked state of a texture, or 0 if there's no room to track it */
+static struct TextureState *RenderStateTexture(struct RenderState *state, SDL_Texture *tex)
+{
+	struct TextureState *ts;
+	struct TextureState *unused = 0;
+	
+	assert(state);
+	assert(tex);
+	
+	for (ts = state->texture; ts < state->texture + TEXTURE_MAX; ++ts)
+	{
+		if (ts->tex == tex)
+			return ts;
+		if (!ts->tex && !unused)
+			unused = ts;
+	}
+	
+	if (unused)
+	{
+		memset(unused, 0, sizeof(*unused));
+		unused->tex = tex;
+	}
+	
+	return unused;
+}
+
+/* tally whether a state change was needed */
+static int RenderStateTally(struct RenderState *state, int needed)
+{
+	assert(state);
+	
+	if (needed)
+		state->changes += 1;
+	else
+		state->elided += 1;
+	
+	return needed;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate a state tracker for the game's renderer */
+struct RenderState *RenderStateNew(struct Flappy *game)
+{
+	struct RenderState *state = calloc(1, sizeof(*state));
+	
+	assert(game);
+	assert(game->renderer);
+	
+	if (!state)
+		return 0;
+	
+	state->renderer = game->renderer;
+	
+	return state;
+}
+
+void RenderStateFree(struct RenderState *state)
+{
+	assert(state);
+	
+	free(state);
+}
+
+/* forget everything that's known about the renderer's state (e.g. when
+ * the renderer has been reset), so the next change of each kind goes
+ * through to SDL
+ */
+void RenderStateInvalidate(struct Flappy *game)
+{
+	struct RenderState *state;
+	
+	assert(game);
+	assert(game->renderState);
+	
+	state = game->renderState;
+	
+	state->targetKnown = 0;
+	state->blendKnown = 0;
+	memset(state->texture, 0, sizeof(state->texture));
+}
+
+/* stop tracking a texture that's about to be destroyed */
+void RenderStateForgetTexture(struct Flappy *game, SDL_Texture *tex)
+{
+	struct TextureState *ts;
+	
+	assert(game);
+	assert(game->renderState);
+	
+	for (ts = game->renderState->texture; ts < game->renderState->texture + TEXTURE_MAX; ++ts)
+		if (ts->tex == tex)
+			memset(ts, 0, sizeof(*ts));
+}
+
+void RenderStateSetTarget(struct Flappy *game, SDL_Texture *target)
+{
+	struct RenderState *state;
+	
+	assert(game);
+	assert(game->renderState);
+	
+	state = game->renderState;
+	
+	if (!RenderStateTally(state, !state->targetKnown || state->target != target))
+		return;
+	
+	SDL_SetRenderTarget(state->renderer, target);
+	state->target = target;
+	state->targetKnown = 1;
+}
+
+void RenderStateSetDrawBlendMode(struct Flappy *game, SDL_BlendMode blend)
+{
+	struct RenderState *state;
+	
+	assert(game);
+	assert(game->renderState);
+	
+	state = game->renderState;
+	
+	if (!RenderStateTally(state, !state->blendKnown || state->blend != blend))
+		return;
+	
+	SDL_SetRenderDrawBlendMode(state->renderer, blend);
+	state->blend = blend;
+	state->blendKnown = 1;
+}
+
+void RenderStateSetTextureColorMod(struct Flappy *game, SDL_Texture *tex, uint8_t r, uint8_t g, uint8_t b)
+{
+	struct TextureState *ts;
+	
+	assert(game);
+	assert(game->renderState);
+	assert(tex);
+	
+	ts = RenderStateTexture(game->renderState, tex);
+	
+	if (!RenderStateTally(game->renderState, !ts
+		|| !ts->modKnown
+		|| ts->mod.r != r
+		|| ts->mod.g != g
+		|| ts->mod.b != b
+	))
+		return;
+	
+	SDL_SetTextureColorMod(tex, r, g, b);
+	if (ts)
+	{
+		ts->mod.r = r;
+		ts->mod.g = g;
+		ts->mod.b = b;
+		ts->modKnown = 1;
+	}
+}
+
+void RenderStateSetTextureAlphaMod(struct Flappy *game, SDL_Texture *tex, uint8_t a)
+{
+	struct TextureState *ts;
+	
+	assert(game);
+	assert(game->renderState);
+	assert(tex);
+	
+	ts = RenderStateTexture(game->renderState, tex);
+	
+	if (!RenderStateTally(game->renderState, !ts || !ts->alphaKnown || ts->mod.a != a))
+		return;
+	
+	SDL_SetTextureAlphaMod(tex, a);
+	if (ts)
+	{
+		ts->mod.a = a;
+		ts->alphaKnown = 1;
+	}
+}
+
+void RenderStateSetTextureBlendMode(struct Flappy *game, SDL_Texture *tex, SDL_BlendMode blend)
+{
+	struct TextureState *ts;
+	
+	assert(game);
+	assert(game->renderState);
+	assert(tex);
+	
+	ts = RenderStateTexture(game->renderState, tex);
+	
+	if (!RenderStateTally(game->renderState, !ts || !ts->blendKnown || ts->blend != blend))
+		return;
+	
+	SDL_SetTextureBlendMode(tex, blend);
+	if (ts)
+	{
+		ts->blend = blend;
+		ts->blendKnown = 1;
+	}
+}
+
+/* get running totals of state changes made and skipped */
+void RenderStateGetCounts(struct Flappy *game, unsigned *changes, unsigned *elided)
+{
+	assert(game);
+	assert(game->renderState);
+	
+	if (changes)
+		*changes = game->renderState->changes;
+	if (elided)
+		*elided = game->renderState->elided;
+}
@@ -0,0 +1,924 @@
+/*
+ * software.c <z64.me>
+ *
+ * a software rasterizer for hosts without a GPU; quads
+ * recorded by the sprite batch are blended straight into
+ * a native resolution framebuffer, which is uploaded to
+ * the frame texture once per frame
+ *
+ * the blending math follows the integer math SDL's own
+ * software renderer uses; SoftwareValidate() compares the
+ * two, pixel for pixel
+ *
+ */
+
+#include "common.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define ALPHA_MASK  0xff000000 /* alpha bits of an argb8888 pixel */
+#define LAYER_MAX   16         /* number of full-screen layers cached */
+#define TILE_SIZE   8          /* dimensions of a dirty-tracking tile */
+#define TILES_X     ((WINDOW_W + TILE_SIZE - 1) / TILE_SIZE)
+#define TILES_Y     ((WINDOW_H + TILE_SIZE - 1) / TILE_SIZE)
+#define HASH_BASIS  2166136261u /* fnv-1a */
+#define HASH_PRIME  16777619u
+
+/* a run of quads sharing one texture, queued for rasterizing */
+struct Run
+{
+	SDL_Texture        *tex;       /* 0 = solid */
+	const SDL_Vertex   *vert;      /* owned by the sprite batch */
+	int                 quadNum;
+};
+
+/* an opaque, full-screen image, stored contiguously so it can be
+ * drawn with a single copy (backgrounds, one per theme and frame)
+ */
+struct Layer
+{
+	SDL_Rect            clip;      /* location within texture */
+	uint32_t           *pix;       /* framebuffer-sized copy (0 = not opaque) */
+};
+
+struct Software
+{
+	uint32_t           *fb;        /* argb8888 framebuffer */
+	int                 w;         /* dimensions of framebuffer */
+	int                 h;
+	SDL_Texture        *tex;       /* texture whose pixels are mirrored below */
+	uint32_t           *texPix;    /* argb8888 copy of texture contents */
+	const uint16_t     *texSpan;   /* span table for texture (owned by atlas) */
+	int                 texW;
+	int                 texH;
+	struct Layer        layer[LAYER_MAX];
+	int                 layerNum;
+	struct Run         *run;       /* runs queued this frame */
+	int                 runNum;
+	int                 runCap;
+	uint32_t            tile[TILES_Y][TILES_X];     /* hash of quads in each tile */
+	uint32_t            tileLast[TILES_Y][TILES_X]; /* same, as of last frame */
+	int                 tileLastValid;              /* framebuffer matches tileLast */
+	SDL_Rect            dirty[TILES_X * TILES_Y];   /* regions redrawn last frame */
+	int                 dirtyNum;
+};
+
+/* a framebuffer or texture, for the rasterizer's purposes */
+struct Raster
+{
+	uint32_t           *pix;
+	int                 w;
+	int                 h;
+	const uint16_t     *span;      /* span table for pixels (0 = none) */
+};
+
+/* blend one pixel, exactly the way SDL_BLENDMODE_BLEND does in software */
+static inline uint32_t BlendPixel(uint32_t d, uint32_t s, SDL_Color mod)
+{
+	unsigned sA = ((s >> 24)       ) * mod.a / 255;
+	unsigned sR = ((s >> 16) & 0xff) * mod.r / 255;
+	unsigned sG = ((s >>  8) & 0xff) * mod.g / 255;
+	unsigned sB = ((s      ) & 0xff) * mod.b / 255;
+	unsigned dA = ((d >> 24)       );
+	unsigned dR = ((d >> 16) & 0xff);
+	unsigned dG = ((d >>  8) & 0xff);
+	unsigned dB = ((d      ) & 0xff);
+	
+	if (sA < 255)
+	{
+		sR = sR * sA / 255;
+		sG = sG * sA / 255;
+		sB = sB * sA / 255;
+	}
+	
+	dR = sR + (255 - sA) * dR / 255;
+	dG = sG + (255 - sA) * dG / 255;
+	dB = sB + (255 - sA) * dB / 255;
+	dA = sA + (255 - sA) * dA / 255;
+	
+	return (dA << 24) | (dR << 16) | (dG << 8) | dB;
+}
+
+/* blend a row of `num` pixels, one at a time */
+static void SpanScalar(uint32_t *dst, const uint32_t *src, int num, SDL_Color mod)
+{
+	int i;
+	
+	for (i = 0; i < num; ++i)
+		dst[i] = BlendPixel(dst[i], src[i], mod);
+}
+
+#ifdef __SSE2__
+/* x / 255 in each 16-bit lane, exact for every product of two bytes */
+static inline __m128i Div255(__m128i x)
+{
+	return _mm_srli_epi16(_mm_mulhi_epu16(x, _mm_set1_epi16((short)0x8081)), 7);
+}
+
+/* BlendPixel() for the two pixels held in 16-bit lanes */
+static inline __m128i BlendHalf(__m128i d, __m128i s, __m128i mod)
+{
+	const __m128i alphaLanes = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+	__m128i a;
+	__m128i inv;
+	
+	s = Div255(_mm_mullo_epi16(s, mod));
+	a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+	inv = _mm_sub_epi16(_mm_set1_epi16(0xff), a);
+	
+	/* premultiply color but not alpha (s * 255 / 255 == s) */
+	s = Div255(_mm_mullo_epi16(s, _mm_or_si128(a, alphaLanes)));
+	
+	return _mm_add_epi16(s, Div255(_mm_mullo_epi16(d, inv)));
+}
+
+/* BlendPixel() for four pixels */
+static inline __m128i Blend4(__m128i d, __m128i s, __m128i mod)
+{
+	const __m128i zero = _mm_setzero_si128();
+	
+	return _mm_packus_epi16(
+		BlendHalf(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), mod)
+		, BlendHalf(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), mod)
+	);
+}
+#endif /* __SSE2__ */
+
+/* blend a row of `num` pixels, with no shortcuts */
+static void Blend(uint32_t *dst, const uint32_t *src, int num, SDL_Color mod)
+{
+	int i = 0;
+	
+#ifdef __SSE2__
+	const __m128i modv = _mm_set_epi16(mod.a, mod.r, mod.g, mod.b, mod.a, mod.r, mod.g, mod.b);
+	
+	for ( ; i + 4 <= num; i += 4)
+		_mm_storeu_si128((__m128i*)(dst + i), Blend4(
+			_mm_loadu_si128((const __m128i*)(dst + i))
+			, _mm_loadu_si128((const __m128i*)(src + i))
+			, modv
+		));
+#endif
+	
+	SpanScalar(dst + i, src + i, num - i, mod);
+}
+
+/* blend a row of `num` pixels, walking its span table so transparent
+ * runs are skipped and (with no modulation) opaque runs are copied
+ */
+static void SpanRuns(uint32_t *dst, const uint32_t *src, const uint16_t *span, int num, SDL_Color mod)
+{
+	int plain = (mod.r & mod.g & mod.b & mod.a) == 0xff;
+	int i;
+	
+	for (i = 0; i < num; )
+	{
+		int type = SPAN_TYPE(span[i]);
+		int len = SDL_min(SPAN_LENGTH(span[i]), num - i);
+		
+		assert(len);
+		
+		if (type == SPAN_OPAQUE && plain)
+			memcpy(dst + i, src + i, len * sizeof(*dst));
+		else if (type != SPAN_CLEAR)
+			Blend(dst + i, src + i, len, mod);
+		
+		i += len;
+	}
+}
+
+/* blend a row of `num` pixels; with no modulation, runs of opaque
+ * pixels are copied and runs of transparent pixels are skipped
+ */
+static void Span(uint32_t *dst, const uint32_t *src, int num, SDL_Color mod)
+{
+	int plain = (mod.r & mod.g & mod.b & mod.a) == 0xff;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128i modv = _mm_set_epi16(mod.a, mod.r, mod.g, mod.b, mod.a, mod.r, mod.g, mod.b);
+	const __m128i alpha4 = _mm_set1_epi32(ALPHA_MASK);
+	const __m128i zero4 = _mm_setzero_si128();
+
+#ifdef __AVX2__
+	const __m256i alpha8 = _mm256_set1_epi32(ALPHA_MASK);
+	const __m256i zero8 = _mm256_setzero_si256();
+	
+	for ( ; i + 8 <= num; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i a = _mm256_and_si256(s, alpha8);
+		
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, zero8)) == -1)
+			continue;
+		
+		if (plain && _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, alpha8)) == -1)
+		{
+			_mm256_storeu_si256((__m256i*)(dst + i), s);
+			continue;
+		}
+		
+		_mm_storeu_si128((__m128i*)(dst + i), Blend4(
+			_mm_loadu_si128((const __m128i*)(dst + i))
+			, _mm256_castsi256_si128(s)
+			, modv
+		));
+		_mm_storeu_si128((__m128i*)(dst + i + 4), Blend4(
+			_mm_loadu_si128((const __m128i*)(dst + i + 4))
+			, _mm256_extracti128_si256(s, 1)
+			, modv
+		));
+	}
+#endif /* __AVX2__ */
+	
+	for ( ; i + 4 <= num; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i a = _mm_and_si128(s, alpha4);
+		
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, zero4)) == 0xffff)
+			continue;
+		
+		if (plain && _mm_movemask_epi8(_mm_cmpeq_epi32(a, alpha4)) == 0xffff)
+		{
+			_mm_storeu_si128((__m128i*)(dst + i), s);
+			continue;
+		}
+		
+		_mm_storeu_si128((__m128i*)(dst + i), Blend4(
+			_mm_loadu_si128((const __m128i*)(dst + i)), s, modv
+		));
+	}
+#endif /* __SSE2__ */
+	
+	/* remaining pixels (or all of them, without SIMD) */
+	for ( ; i < num; ++i)
+	{
+		uint32_t s = src[i];
+		
+		if (!(s & ALPHA_MASK))
+			continue;
+		
+		dst[i] = (plain && (s & ALPHA_MASK) == ALPHA_MASK) ? s : BlendPixel(dst[i], s, mod);
+	}
+}
+
+/* fill a row of `num` pixels with a solid color */
+static void Fill(uint32_t *dst, int num, SDL_Color color)
+{
+	const SDL_Color white = {0xff, 0xff, 0xff, 0xff};
+	uint32_t c = ((uint32_t)color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
+	int i = 0;
+	
+	if (!color.a)
+		return;
+	
+	if (color.a == 0xff)
+	{
+		for (i = 0; i < num; ++i)
+			dst[i] = c;
+		return;
+	}
+
+#ifdef __SSE2__
+	{
+		const __m128i s = _mm_set1_epi32(c);
+		const __m128i modv = _mm_set1_epi16(0xff);
+		
+		for ( ; i + 4 <= num; i += 4)
+			_mm_storeu_si128((__m128i*)(dst + i), Blend4(
+				_mm_loadu_si128((const __m128i*)(dst + i)), s, modv
+			));
+	}
+#endif
+	
+	for ( ; i < num; ++i)
+		dst[i] = BlendPixel(dst[i], c, white);
+}
+
+/* draw one batched quad (four vertices) onto `fb`, sampling from `tex`
+ * (or filling with the vertex color if `tex` is 0), touching only the
+ * pixels within `scissor` (0 = all of them); `scalar` forces the
+ * reference implementation, for validation
+ */
+static void RasterQuad(struct Raster *fb, const struct Raster *tex, const SDL_Vertex *v, const SDL_Rect *scissor, int scalar)
+{
+	SDL_Rect bounds = {0, 0, fb->w, fb->h};
+	SDL_Rect dst;
+	SDL_Rect clip = {0};
+	SDL_Color mod = v[0].color;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int y;
+	
+	assert(fb);
+	assert(v);
+	
+	/* quads are axis-aligned, with integer corners (see BatchSetQuad) */
+	dst.x = v[0].position.x;
+	dst.y = v[0].position.y;
+	dst.w = v[2].position.x - dst.x;
+	dst.h = v[2].position.y - dst.y;
+	
+	if (scissor)
+		bounds = *scissor;
+	
+	x0 = SDL_max(dst.x, bounds.x);
+	y0 = SDL_max(dst.y, bounds.y);
+	x1 = SDL_min(dst.x + dst.w, bounds.x + bounds.w);
+	y1 = SDL_min(dst.y + dst.h, bounds.y + bounds.h);
+	
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	
+	if (!tex)
+	{
+		for (y = y0; y < y1; ++y)
+		{
+			uint32_t *row = fb->pix + y * fb->w + x0;
+			
+			if (scalar)
+			{
+				int x;
+				
+				for (x = 0; x < x1 - x0; ++x)
+					row[x] = BlendPixel(row[x], 0xffffffff, mod);
+			}
+			else
+				Fill(row, x1 - x0, mod);
+		}
+		return;
+	}
+	
+	clip.x = ROUNDING(v[0].tex_coord.x * tex->w);
+	clip.y = ROUNDING(v[0].tex_coord.y * tex->h);
+	clip.w = ROUNDING(v[2].tex_coord.x * tex->w) - clip.x;
+	clip.h = ROUNDING(v[2].tex_coord.y * tex->h) - clip.y;
+	
+	for (y = y0; y < y1; ++y)
+	{
+		uint32_t *row = fb->pix + y * fb->w + x0;
+		
+		/* 1:1, which is how everything in the game is drawn */
+		if (clip.w == dst.w && clip.h == dst.h)
+		{
+			const uint32_t *src = tex->pix
+				+ (clip.y + y - dst.y) * tex->w
+				+ clip.x + x0 - dst.x
+			;
+			
+			if (scalar)
+				SpanScalar(row, src, x1 - x0, mod);
+			else if (tex->span)
+				SpanRuns(row, src, tex->span + (src - tex->pix), x1 - x0, mod);
+			else
+				Span(row, src, x1 - x0, mod);
+		}
+		
+		/* scaled, using nearest neighbor sampling */
+		else
+		{
+			const uint32_t *src = tex->pix + (clip.y + (y - dst.y) * clip.h / dst.h) * tex->w;
+			int x;
+			
+			for (x = x0; x < x1; ++x)
+				row[x - x0] = BlendPixel(row[x - x0], src[clip.x + (x - dst.x) * clip.w / dst.w], mod);
+		}
+	}
+}
+
+/* draw a quad that covers the whole framebuffer from a cached layer, if
+ * it's an unmodulated copy of opaque pixels; only the pixels within
+ * `scissor` are touched; returns non-zero on success
+ */
+static int RasterLayer(struct Software *sw, const SDL_Vertex *v, const SDL_Rect *scissor)
+{
+	struct Layer *layer;
+	SDL_Rect clip;
+	int y;
+	
+	assert(sw);
+	assert(v);
+	assert(scissor);
+	
+	if (v[0].position.x != 0
+		|| v[0].position.y != 0
+		|| v[2].position.x != sw->w
+		|| v[2].position.y != sw->h
+		|| (v[0].color.r & v[0].color.g & v[0].color.b & v[0].color.a) != 0xff
+	)
+		return 0;
+	
+	clip.x = ROUNDING(v[0].tex_coord.x * sw->texW);
+	clip.y = ROUNDING(v[0].tex_coord.y * sw->texH);
+	clip.w = ROUNDING(v[2].tex_coord.x * sw->texW) - clip.x;
+	clip.h = ROUNDING(v[2].tex_coord.y * sw->texH) - clip.y;
+	
+	if (clip.w != sw->w || clip.h != sw->h)
+		return 0;
+	
+	for (layer = sw->layer; layer < sw->layer + sw->layerNum; ++layer)
+		if (layer->clip.x == clip.x && layer->clip.y == clip.y)
+			break;
+	
+	/* first time this layer has been seen */
+	if (layer == sw->layer + sw->layerNum)
+	{
+		int opaque = 1;
+		
+		if (sw->layerNum == LAYER_MAX)
+			return 0;
+		
+		for (y = 0; y < clip.h && opaque; ++y)
+		{
+			uint16_t span = sw->texSpan[(clip.y + y) * sw->texW + clip.x];
+			
+			opaque = SPAN_TYPE(span) == SPAN_OPAQUE && SPAN_LENGTH(span) >= clip.w;
+		}
+		
+		layer->clip = clip;
+		layer->pix = 0;
+		sw->layerNum += 1;
+		
+		if (opaque)
+		{
+			if (!(layer->pix = malloc(sw->w * sw->h * sizeof(*layer->pix))))
+				FlappyFatal("memory error");
+			
+			for (y = 0; y < clip.h; ++y)
+				memcpy(
+					layer->pix + y * sw->w
+					, sw->texPix + (clip.y + y) * sw->texW + clip.x
+					, sw->w * sizeof(*layer->pix)
+				);
+		}
+	}
+	
+	if (!layer->pix)
+		return 0;
+	
+	for (y = scissor->y; y < scissor->y + scissor->h; ++y)
+		memcpy(
+			sw->fb + y * sw->w + scissor->x
+			, layer->pix + y * sw->w + scissor->x
+			, scissor->w * sizeof(*sw->fb)
+		);
+	
+	return 1;
+}
+
+/* fold a quad into the hashes of every tile it touches */
+static void HashQuad(struct Software *sw, SDL_Texture *tex, const SDL_Vertex *v)
+{
+	const uint8_t *b;
+	uint32_t hash = HASH_BASIS;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int x;
+	int y;
+	
+	assert(sw);
+	assert(v);
+	
+	x0 = SDL_max((int)v[0].position.x, 0);
+	y0 = SDL_max((int)v[0].position.y, 0);
+	x1 = SDL_min((int)v[2].position.x, sw->w);
+	y1 = SDL_min((int)v[2].position.y, sw->h);
+	
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	
+	/* opposite corners, their colors and texture coordinates, and the
+	 * texture itself describe an axis-aligned quad completely
+	 */
+	for (b = (const uint8_t*)&v[0]; b < (const uint8_t*)&v[1]; ++b)
+		hash = (hash ^ *b) * HASH_PRIME;
+	for (b = (const uint8_t*)&v[2]; b < (const uint8_t*)&v[3]; ++b)
+		hash = (hash ^ *b) * HASH_PRIME;
+	for (b = (const uint8_t*)&tex; b < (const uint8_t*)(&tex + 1); ++b)
+		hash = (hash ^ *b) * HASH_PRIME;
+	
+	/* drawing order matters, so tile hashes are chained */
+	for (y = y0 / TILE_SIZE; y <= (y1 - 1) / TILE_SIZE; ++y)
+		for (x = x0 / TILE_SIZE; x <= (x1 - 1) / TILE_SIZE; ++x)
+			sw->tile[y][x] = (sw->tile[y][x] ^ hash) * HASH_PRIME;
+}
+
+/* gather the tiles whose contents changed since last frame into
+ * rectangles (runs of tiles within a row, merged with identical runs
+ * in the row above)
+ */
+static void FindDirty(struct Software *sw)
+{
+	int x;
+	int y;
+	
+	assert(sw);
+	
+	sw->dirtyNum = 0;
+	
+	for (y = 0; y < TILES_Y; ++y)
+	{
+		int rowEnd = sw->dirtyNum;
+		
+		for (x = 0; x < TILES_X; )
+		{
+			SDL_Rect r;
+			int i;
+			
+			if (sw->tileLastValid && sw->tile[y][x] == sw->tileLast[y][x])
+			{
+				++x;
+				continue;
+			}
+			
+			r.x = x * TILE_SIZE;
+			r.y = y * TILE_SIZE;
+			while (x < TILES_X && (!sw->tileLastValid || sw->tile[y][x] != sw->tileLast[y][x]))
+				++x;
+			r.w = SDL_min(x * TILE_SIZE, sw->w) - r.x;
+			r.h = SDL_min(r.y + TILE_SIZE, sw->h) - r.y;
+			
+			/* extend a rectangle from the row above, if one lines up */
+			for (i = 0; i < rowEnd; ++i)
+			{
+				SDL_Rect *above = &sw->dirty[i];
+				
+				if (above->x == r.x && above->w == r.w && above->y + above->h == r.y)
+				{
+					above->h += r.h;
+					break;
+				}
+			}
+			
+			if (i == rowEnd)
+				sw->dirty[sw->dirtyNum++] = r;
+		}
+	}
+}
+
+/* convert rgba8888 (byte order) pixels to argb8888 */
+static void ConvertPixels(uint32_t *dst, const uint32_t *src, int num)
+{
+	int i;
+	
+	for (i = 0; i < num; ++i)
+	{
+		const uint8_t *c = (const uint8_t*)(src + i);
+		
+		dst[i] = ((uint32_t)c[3] << 24) | (c[0] << 16) | (c[1] << 8) | c[2];
+	}
+}
+
+/* a small xorshift generator, so validation is repeatable */
+static uint32_t ValidateRand(uint32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	
+	return *state;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* allocate a software rasterizer drawing the game's atlas into a
+ * native resolution framebuffer; the atlas must already be built
+ */
+struct Software *SoftwareNew(struct Flappy *game)
+{
+	struct Software *sw = calloc(1, sizeof(*sw));
+	const uint32_t *pix;
+	int i;
+	
+	assert(game);
+	assert(game->atlas);
+	
+	if (!sw)
+		return 0;
+	
+	sw->w = WINDOW_W;
+	sw->h = WINDOW_H;
+	sw->tex = AtlasGetTexture(game->atlas);
+	sw->texSpan = AtlasGetSpans(game->atlas);
+	pix = AtlasGetPixels(game->atlas, &sw->texW, &sw->texH);
+	
+	if (!(sw->fb = calloc(sw->w * sw->h, sizeof(*sw->fb)))
+		|| !(sw->texPix = malloc(sw->texW * sw->texH * sizeof(*sw->texPix)))
+	)
+	{
+		SoftwareFree(sw);
+		return 0;
+	}
+	
+	ConvertPixels(sw->texPix, pix, sw->texW * sw->texH);
+	
+	for (i = 0; i < TILES_X * TILES_Y; ++i)
+		sw->tile[i / TILES_X][i % TILES_X] = HASH_BASIS;
+	
+	return sw;
+}
+
+/* deallocate a software rasterizer */
+void SoftwareFree(struct Software *sw)
+{
+	int i;
+	
+	assert(sw);
+	
+	for (i = 0; i < sw->layerNum; ++i)
+		free(sw->layer[i].pix);
+	free(sw->run);
+	free(sw->fb);
+	free(sw->texPix);
+	free(sw);
+}
+
+/* queue a run of batched quads sharing one texture (0 = solid); the
+ * vertices must stay put until SoftwareUpload()
+ */
+void SoftwareQuads(struct Flappy *game, SDL_Texture *tex, const SDL_Vertex *vert, int quadNum)
+{
+	struct Software *sw;
+	int i;
+	
+	assert(game);
+	assert(game->software);
+	assert(vert || !quadNum);
+	
+	sw = game->software;
+	
+	/* the atlas is the only texture drawn at native resolution */
+	assert(!tex || tex == sw->tex);
+	
+	if (sw->runNum == sw->runCap)
+	{
+		sw->runCap = sw->runCap ? sw->runCap * 2 : 64;
+		if (!(sw->run = realloc(sw->run, sw->runCap * sizeof(*sw->run))))
+			FlappyFatal("memory error");
+	}
+	sw->run[sw->runNum++] = (struct Run){tex, vert, quadNum};
+	
+	for (i = 0; i < quadNum; ++i)
+		HashQuad(sw, tex, vert + i * 4);
+}
+
+/* draw the quads queued this frame into the framebuffer, redrawing only
+ * the tiles whose quads differ from last frame, then copy the regions
+ * that changed into a texture of the same dimensions
+ */
+void SoftwareUpload(struct Flappy *game, SDL_Texture *dst)
+{
+	struct Software *sw;
+	struct Raster fb;
+	struct Raster src;
+	struct Run *run;
+	int i;
+	int k;
+	
+	assert(game);
+	assert(game->software);
+	assert(dst);
+	
+	sw = game->software;
+	fb = (struct Raster){sw->fb, sw->w, sw->h, 0};
+	src = (struct Raster){sw->texPix, sw->texW, sw->texH, sw->texSpan};
+	
+	FindDirty(sw);
+	
+	for (k = 0; k < sw->dirtyNum; ++k)
+	{
+		const SDL_Rect *scissor = &sw->dirty[k];
+		
+		for (run = sw->run; run < sw->run + sw->runNum; ++run)
+		{
+			for (i = 0; i < run->quadNum; ++i)
+			{
+				const SDL_Vertex *v = run->vert + i * 4;
+				
+				if (!run->tex || !RasterLayer(sw, v, scissor))
+					RasterQuad(&fb, run->tex ? &src : 0, v, scissor, 0);
+			}
+		}
+		
+		SDL_UpdateTexture(dst, scissor, sw->fb + scissor->y * sw->w + scissor->x, sw->w * sizeof(*sw->fb));
+	}
+	
+	/* start hashing the next frame */
+	memcpy(sw->tileLast, sw->tile, sizeof(sw->tile));
+	for (i = 0; i < TILES_X * TILES_Y; ++i)
+		sw->tile[i / TILES_X][i % TILES_X] = HASH_BASIS;
+	sw->tileLastValid = 1;
+	sw->runNum = 0;
+}
+
+/* redraw everything next frame (e.g. when the texture lost its contents) */
+void SoftwareInvalidate(struct Flappy *game)
+{
+	assert(game);
+	assert(game->software);
+	
+	game->software->tileLastValid = 0;
+}
+
+/* get the regions of the framebuffer that changed in the last upload */
+const SDL_Rect *SoftwareGetDirty(struct Flappy *game, int *num)
+{
+	assert(game);
+	assert(game->software);
+	assert(num);
+	
+	*num = game->software->dirtyNum;
+	
+	return game->software->dirty;
+}
+
+/* get the framebuffer, as of the last upload (argb8888, native resolution) */
+const uint32_t *SoftwareGetPixels(struct Flappy *game)
+{
+	assert(game);
+	assert(game->software);
+	
+	return game->software->fb;
+}
+
+/* draw a corpus of random sprites and rectangles, comparing the fast
+ * paths (with and without span tables) against the reference
+ * implementation, and the reference against what SDL's own software
+ * renderer reads back; returns the number of pixels that differ, or
+ * -1 if SDL's software renderer couldn't be used to check
+ */
+int SoftwareValidate(void)
+{
+	enum { TEX_W = 64, TEX_H = 64, QUAD_NUM = 2000 };
+	static uint32_t texRgba[TEX_W * TEX_H];
+	static uint32_t texArgb[TEX_W * TEX_H];
+	static uint16_t texSpan[TEX_W * TEX_H];
+	static uint32_t fbFast[WINDOW_W * WINDOW_H];
+	static uint32_t fbSpan[WINDOW_W * WINDOW_H];
+	static uint32_t fbRef[WINDOW_W * WINDOW_H];
+	static uint32_t fbSdl[WINDOW_W * WINDOW_H];
+	static SDL_Vertex vert[QUAD_NUM * 4];
+	static int index[QUAD_NUM * 6];
+	const uint8_t alphas[] = {0, 0, 0, 255, 255, 255, 1, 254};
+	struct Raster fast = {fbFast, WINDOW_W, WINDOW_H, 0};
+	struct Raster spans = {fbSpan, WINDOW_W, WINDOW_H, 0};
+	struct Raster ref = {fbRef, WINDOW_W, WINDOW_H, 0};
+	struct Raster tex = {texArgb, TEX_W, TEX_H, 0};
+	struct Raster texSpanned = {texArgb, TEX_W, TEX_H, texSpan};
+	uint8_t alpha = 0;
+	SDL_Surface *surf;
+	SDL_Renderer *renderer;
+	uint32_t seed = 0x2545f491;
+	int errors = 0;
+	int i;
+	
+	/* pixel art, with mostly binary alpha that changes every few pixels */
+	for (i = 0; i < TEX_W * TEX_H; ++i)
+	{
+		uint8_t *c = (uint8_t*)(texRgba + i);
+		uint32_t r = ValidateRand(&seed);
+		
+		if ((r >> 24) % 6 == 0)
+			alpha = alphas[(r >> 27) % ARRAY_COUNT(alphas)];
+		
+		c[0] = r;
+		c[1] = r >> 8;
+		c[2] = r >> 16;
+		c[3] = alpha;
+	}
+	ConvertPixels(texArgb, texRgba, TEX_W * TEX_H);
+	SpanTableBuild(texSpan, texRgba, TEX_W, TEX_H);
+	
+	/* start from a partially transparent background */
+	for (i = 0; i < WINDOW_W * WINDOW_H; ++i)
+		fbFast[i] = fbSpan[i] = fbRef[i] = ValidateRand(&seed) | 0x80000000;
+	
+	/* unscaled quads at integer positions, some partially off-screen;
+	 * the last ones are solid, to exercise rectangle filling
+	 */
+	for (i = 0; i < QUAD_NUM; ++i)
+	{
+		SDL_Vertex *v = vert + i * 4;
+		int w = 1 + ValidateRand(&seed) % TEX_W;
+		int h = 1 + ValidateRand(&seed) % TEX_H;
+		int sx = ValidateRand(&seed) % (TEX_W - w + 1);
+		int sy = ValidateRand(&seed) % (TEX_H - h + 1);
+		int x = (int)(ValidateRand(&seed) % (WINDOW_W + w)) - w / 2;
+		int y = (int)(ValidateRand(&seed) % (WINDOW_H + h)) - h / 2;
+		uint32_t r = ValidateRand(&seed);
+		SDL_Color color = {0xff, 0xff, 0xff, 0xff};
+		
+		if (r % 4 == 0)
+			color = (SDL_Color){r >> 8, r >> 16, r >> 24, (r >> 4) & 1 ? 0xff : r >> 12};
+		
+		v[0].position = (SDL_FPoint){x, y};
+		v[1].position = (SDL_FPoint){x + w, y};
+		v[2].position = (SDL_FPoint){x + w, y + h};
+		v[3].position = (SDL_FPoint){x, y + h};
+		v[0].tex_coord = (SDL_FPoint){(float)sx / TEX_W, (float)sy / TEX_H};
+		v[1].tex_coord = (SDL_FPoint){(float)(sx + w) / TEX_W, (float)sy / TEX_H};
+		v[2].tex_coord = (SDL_FPoint){(float)(sx + w) / TEX_W, (float)(sy + h) / TEX_H};
+		v[3].tex_coord = (SDL_FPoint){(float)sx / TEX_W, (float)(sy + h) / TEX_H};
+		v[0].color = v[1].color = v[2].color = v[3].color = color;
+		
+		index[i * 6 + 0] = i * 4 + 0;
+		index[i * 6 + 1] = i * 4 + 1;
+		index[i * 6 + 2] = i * 4 + 2;
+		index[i * 6 + 3] = i * 4 + 0;
+		index[i * 6 + 4] = i * 4 + 2;
+		index[i * 6 + 5] = i * 4 + 3;
+	}
+	
+	/* the same quads, through SDL's software renderer */
+	surf = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_W, WINDOW_H, 32, SDL_PIXELFORMAT_ARGB8888);
+	renderer = surf ? SDL_CreateSoftwareRenderer(surf) : 0;
+	if (renderer)
+	{
+		SDL_Surface *texSurf;
+		SDL_Texture *sdlTex = 0;
+		
+		for (i = 0; i < WINDOW_H; ++i)
+			memcpy((uint8_t*)surf->pixels + i * surf->pitch, fbRef + i * WINDOW_W, WINDOW_W * sizeof(*fbRef));
+		
+		if ((texSurf = SDL_CreateRGBSurfaceWithFormatFrom(texRgba, TEX_W, TEX_H, 32, TEX_W * 4, SDL_PIXELFORMAT_RGBA32)))
+		{
+			sdlTex = SDL_CreateTextureFromSurface(renderer, texSurf);
+			SDL_FreeSurface(texSurf);
+		}
+		
+		if (sdlTex)
+		{
+			SDL_SetTextureBlendMode(sdlTex, SDL_BLENDMODE_BLEND);
+			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+			SDL_RenderGeometry(renderer, sdlTex, vert, (QUAD_NUM * 3 / 4) * 4, index, (QUAD_NUM * 3 / 4) * 6);
+			SDL_RenderGeometry(renderer, 0, vert + (QUAD_NUM * 3 / 4) * 4, (QUAD_NUM / 4) * 4, index, (QUAD_NUM / 4) * 6);
+			SDL_DestroyTexture(sdlTex);
+		}
+		
+		if (!sdlTex
+			|| SDL_RenderReadPixels(renderer, 0, SDL_PIXELFORMAT_ARGB8888, fbSdl, WINDOW_W * sizeof(*fbSdl))
+		)
+		{
+			SDL_DestroyRenderer(renderer);
+			renderer = 0;
+		}
+	}
+	
+	for (i = 0; i < QUAD_NUM; ++i)
+	{
+		int solid = i >= QUAD_NUM * 3 / 4;
+		
+		RasterQuad(&fast, solid ? 0 : &tex, vert + i * 4, 0, 0);
+		RasterQuad(&spans, solid ? 0 : &texSpanned, vert + i * 4, 0, 0);
+		RasterQuad(&ref, solid ? 0 : &tex, vert + i * 4, 0, 1);
+	}
+	
+	for (i = 0; i < WINDOW_W * WINDOW_H; ++i)
+	{
+		uint32_t sdl = renderer ? fbSdl[i] : fbRef[i];
+		
+		if (fbFast[i] != fbRef[i] || fbSpan[i] != fbRef[i] || sdl != fbRef[i])
+		{
+			if (!errors)
+				fprintf(stderr, "pixel %d,%d: expected %08x (sdl) %08x (reference), got %08x %08x (spans)\n"
+					, i % WINDOW_W, i / WINDOW_W, sdl, fbRef[i], fbFast[i], fbSpan[i]
+				);
+			++errors;
+		}
+	}
+	
+	if (renderer)
+		SDL_DestroyRenderer(renderer);
+	if (surf)
+		SDL_FreeSurface(surf);
+	
+	/* the fast paths agreeing with the reference proves nothing about SDL */
+	if (!renderer)
+	{
+		fprintf(stderr, "software validation: SDL's software renderer unavailable (%s)\n", SDL_GetError());
+		return errors ? errors : -1;
+	}
+	
+	return errors;
+}
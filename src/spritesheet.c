@@ -35,7 +35,7 @@ struct Row
 
 struct Spritesheet
 {
-	SDL_Texture *tex;       /* texture image containing graphics */
+	struct Image *image;    /* atlas image containing graphics */
 	struct Row  *row;       /* array of rows */
 	unsigned     rowNum;    /* number of rows */
 };
@@ -68,7 +68,7 @@ struct Spritesheet *SpritesheetFromPixels(struct Flappy *game, const void *pix,
 	if (!(sheet = calloc(1, sizeof(*sheet))))
 		FlappyFatal("memory error");
 	
-	sheet->tex = TextureFromPixels(game, pix, w, h);
+	sheet->image = ImageFromPixels(game, pix, w, h);
 	
 	/* first control pixel should have a transparent
 	 * pixel to its right, and below it; otherwise,
@@ -276,9 +276,11 @@ struct Spritesheet *SpritesheetLoad(struct Flappy *game, const char *filename)
 	assert(filename);
 	
 	/* load, process, and free image data */
+	TRACE_BEGIN(game, "load", filename);
 	data = FileLoad(filename, &sz);
 	sheet = SpritesheetLoadFrom(game, data, sz);
 	FileFree(data);
+	TRACE_END(game, "load", filename);
 	
 	return sheet;
 }
@@ -295,8 +297,7 @@ void SpritesheetFree(struct Flappy *game, struct Spritesheet *sheet)
 	for (row = sheet->row; row < sheet->row + sheet->rowNum; ++row)
 		free(row->sprite);
 	
-	/* and then everything else */
-	SDL_DestroyTexture(sheet->tex);
+	/* and then everything else (the image belongs to the atlas) */
 	free(sheet->row);
 	free(sheet);
 	
@@ -308,7 +309,6 @@ void SpritesheetDraw(struct Flappy *game, struct Spritesheet *sheet, unsigned ro
 {
 	struct Row *rowP;
 	struct Sprite *spriteP;
-	SDL_Rect dst;
 	SDL_Rect clip;
 	
 	assert(game);
@@ -321,21 +321,21 @@ void SpritesheetDraw(struct Flappy *game, struct Spritesheet *sheet, unsigned ro
 	
 	SpriteGetClipRect(rowP, spriteP, &clip.x, &clip.y, &clip.w, &clip.h);
 	
-	dst.x = ROUNDING(x * game->scale);
-	dst.y = ROUNDING(y * game->scale);
-	dst.w = ROUNDING(clip.w * game->scale);
-	dst.h = ROUNDING(clip.h * game->scale);
-	
-	SDL_RenderCopy(game->renderer, sheet->tex, &clip, &dst);
+	ImageDraw(game, sheet->image, clip, x, y);
 }
 
-/* display one of the sprites from a sprite sheet, with a custom scale */
+/* display one of the sprites from a sprite sheet, with a custom scale;
+ * unlike the other drawing functions, this targets the window itself
+ * rather than the native resolution frame, so `x` and `y` are still in
+ * game pixels but `scale` is in window pixels
+ */
 void SpritesheetDrawScaled(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col, float x, float y, float scale)
 {
 	struct Row *rowP;
 	struct Sprite *spriteP;
 	SDL_Rect dst;
 	SDL_Rect clip;
+	SDL_Rect imageRect;
 	
 	assert(game);
 	assert(sheet);
@@ -352,7 +352,34 @@ void SpritesheetDrawScaled(struct Flappy *game, struct Spritesheet *sheet, unsig
 	dst.w = ROUNDING(clip.w * scale);
 	dst.h = ROUNDING(clip.h * scale);
 	
-	SDL_RenderCopy(game->renderer, sheet->tex, &clip, &dst);
+	/* sprite location within atlas */
+	imageRect = ImageGetRect(sheet->image);
+	clip.x += imageRect.x;
+	clip.y += imageRect.y;
+	
+	BatchQuad(game, AtlasGetTexture(game->atlas), clip, dst);
+}
+
+/* get a sprite's clipping rectangle within the atlas */
+SDL_Rect SpritesheetGetClip(struct Flappy *game, struct Spritesheet *sheet, unsigned row, unsigned col)
+{
+	SDL_Rect clip;
+	SDL_Rect imageRect;
+	
+	assert(game);
+	assert(sheet);
+	assert(row < sheet->rowNum);
+	assert(col < sheet->row[row].spriteNum);
+	
+	SpriteGetClipRect(&sheet->row[row], &sheet->row[row].sprite[col], &clip.x, &clip.y, &clip.w, &clip.h);
+	
+	imageRect = ImageGetRect(sheet->image);
+	clip.x += imageRect.x;
+	clip.y += imageRect.y;
+	
+	return clip;
+	
+	(void)game;
 }
 
 /* guess the center and get the world positioning info for a sprite before drawing */
@@ -388,7 +415,6 @@ void SpritesheetDrawCentered(struct Flappy *game, struct Spritesheet *sheet, uns
 {
 	struct Row *rowP;
 	struct Sprite *spriteP;
-	SDL_Rect dst;
 	SDL_Rect clip;
 	
 	assert(game);
@@ -401,19 +427,16 @@ void SpritesheetDrawCentered(struct Flappy *game, struct Spritesheet *sheet, uns
 	
 	SpriteGetClipRect(rowP, spriteP, &clip.x, &clip.y, &clip.w, &clip.h);
 	
-	dst.x = ROUNDING((x - clip.w / 2) * game->scale);
-	dst.y = ROUNDING((y - clip.h / 2) * game->scale);
-	dst.w = ROUNDING(clip.w * game->scale);
-	dst.h = ROUNDING(clip.h * game->scale);
-	
-	SDL_RenderCopy(game->renderer, sheet->tex, &clip, &dst);
+	ImageDraw(game, sheet->image, clip, x - clip.w / 2, y - clip.h / 2);
 }
 
 /* returns pointer to texture image that a sprite sheet uses */
-SDL_Texture *SpritesheetGetTexture(struct Spritesheet *sheet)
+SDL_Texture *SpritesheetGetTexture(struct Flappy *game, struct Spritesheet *sheet)
 {
+	assert(game);
 	assert(sheet);
 	
-	return sheet->tex;
+	return AtlasGetTexture(game->atlas);
+	
+	(void)sheet;
 }
-
@@ -28,7 +28,7 @@ SDL_Texture *TextureFromPixels(struct Flappy *game, const void *pix, int w, int
 		FlappyFatal("SDL_CreateTextureFromSurface error: %s", SDL_GetError());
 	
 	/* set flags */
-	SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+	RenderStateSetTextureBlendMode(game, tex, SDL_BLENDMODE_BLEND);
 	
 	/* cleanup */
 	SDL_FreeSurface(surf);
@@ -87,24 +87,7 @@ void TextureFree(struct Flappy *game, SDL_Texture *tex)
 	assert(game);
 	assert(tex);
 	
+	RenderStateForgetTexture(game, tex);
 	SDL_DestroyTexture(tex);
-	
-	(void)game;
-}
-
-/* display a texture onto the screen */
-void TextureDraw(struct Flappy *game, SDL_Texture *tex, SDL_Rect clip, float x, float y)
-{
-	SDL_Rect dst;
-	
-	assert(game);
-	assert(tex);
-	
-	dst.x = ROUNDING(x * game->scale);
-	dst.y = ROUNDING(y * game->scale);
-	dst.w = ROUNDING(clip.w * game->scale);
-	dst.h = ROUNDING(clip.h * game->scale);
-	
-	SDL_RenderCopy(game->renderer, tex, &clip, &dst);
 }
 
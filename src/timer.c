@@ -14,6 +14,7 @@ struct Timer
 	uint64_t        prev;    /* previous time */
 	uint64_t        now;     /* current time */
 	uint64_t        start;   /* timer creation time */
+	uint32_t        nowMs;   /* SDL_GetTicks() as of `now` */
 };
 
 /* allocate and initialize a new timer */
@@ -37,12 +38,16 @@ void TimerFree(struct Timer *timer)
 	free(timer);
 }
 
+/* advance the timer to the present; `ticks` and `nowMs` are
+ * sampled together, so timestamps map onto game time exactly
+ */
 void TimerAdvance(struct Timer *timer, int isPaused)
 {
-	if (!isPaused)
-		timer->ticks += (double)((timer->now - timer->prev)*1000) / SDL_GetPerformanceFrequency();
 	timer->prev = timer->now;
 	timer->now = SDL_GetPerformanceCounter() - timer->start;
+	timer->nowMs = SDL_GetTicks();
+	if (!isPaused)
+		timer->ticks += (double)((timer->now - timer->prev)*1000) / SDL_GetPerformanceFrequency();
 }
 
 uint32_t TimerGetTicks(struct Timer *timer)
@@ -50,3 +55,23 @@ uint32_t TimerGetTicks(struct Timer *timer)
 	return timer->ticks;
 }
 
+/* same as TimerGetTicks(), without truncating to whole milliseconds */
+double TimerGetTime(struct Timer *timer)
+{
+	return timer->ticks;
+}
+
+/* convert an SDL timestamp (e.g. from an event) to game time; the
+ * current game time is when the timer last advanced, so anything
+ * since then maps to the current game time
+ */
+double TimerGetTimeAt(struct Timer *timer, uint32_t timestamp)
+{
+	int32_t age = timer->nowMs - timestamp;
+	
+	if (age <= 0)
+		return timer->ticks;
+	
+	return timer->ticks - age;
+}
+
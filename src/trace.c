@@ -0,0 +1,267 @@
+/*
+ * trace.c <z64.me>
+ *
+ * timeline tracing: events are recorded into a ring that's
+ * allocated up front, and a writer thread saves them in the
+ * trace event format that chrome://tracing and Perfetto load
+ *
+ * it only exists in builds with FLAPPY_PROFILE defined;
+ * otherwise, the TRACE_*() macros compile to nothing
+ *
+ * events may only be recorded from the game thread, and
+ * their names must stay valid until the trace is freed
+ *
+ */
+
+#include "common.h"
+
+#ifdef FLAPPY_PROFILE
+
+/******************************
+ *
+ * private types and functions
+ *
+ ******************************/
+
+#define TRACE_EVENTS    (1 << 16) /* ring capacity; must be a power of 2 */
+#define TRACE_WAIT_MS   100       /* longest the writer sleeps between flushes */
+
+struct TraceEvent
+{
+	uint64_t            when;      /* performance counter */
+	const char         *cat;       /* category */
+	const char         *name;
+	int                 value;     /* shown as an argument on instant events */
+	char                phase;     /* 'B'egin, 'E'nd, or 'i'nstant */
+};
+
+struct Trace
+{
+	FILE               *fp;
+	const char         *path;      /* for error messages */
+	uint64_t            freq;      /* performance counter frequency */
+	uint64_t            start;     /* timestamps are relative to this */
+	struct TraceEvent  *event;     /* ring of TRACE_EVENTS events */
+	SDL_atomic_t        head;      /* events recorded by the game (wraps; read as unsigned) */
+	SDL_atomic_t        tail;      /* events saved by the writer (wraps; read as unsigned) */
+	SDL_atomic_t        quit;      /* writer should exit once drained */
+	SDL_sem            *wake;      /* ring is filling up */
+	SDL_Thread         *thread;    /* writer */
+	unsigned            written;   /* events saved so far */
+	unsigned            dropped;   /* events lost to a full ring */
+	unsigned            open;      /* slices begun whose end is still to come */
+	unsigned            skip;      /* depth inside a slice whose begin was lost */
+};
+
+/* write a string as a json string */
+static void TraceWriteString(FILE *fp, const char *str)
+{
+	assert(fp);
+	assert(str);
+	
+	fputc('"', fp);
+	for ( ; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char)*str < ' ')
+			fprintf(fp, "\\u%04x", *str);
+		else
+			fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+/* write one event */
+static void TraceWriteEvent(struct Trace *trace, const struct TraceEvent *ev)
+{
+	FILE *fp;
+	
+	assert(trace);
+	assert(ev);
+	
+	fp = trace->fp;
+	
+	fprintf(fp, "%s{\"name\":", trace->written ? ",\n" : "");
+	TraceWriteString(fp, ev->name);
+	fprintf(fp, ",\"cat\":");
+	TraceWriteString(fp, ev->cat);
+	fprintf(fp, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1"
+		, ev->phase
+		, (double)(ev->when - trace->start) * 1000000 / trace->freq
+	);
+	if (ev->phase == 'i')
+		fprintf(fp, ",\"s\":\"t\",\"args\":{\"value\":%d}", ev->value);
+	fprintf(fp, "}");
+	
+	trace->written += 1;
+}
+
+/* writer thread: saves events as they're recorded, so the game
+ * never waits on the file
+ */
+static int TraceThread(void *udata)
+{
+	struct Trace *trace = udata;
+	
+	assert(trace);
+	
+	while (1)
+	{
+		unsigned head = SDL_AtomicGet(&trace->head);
+		unsigned tail = SDL_AtomicGet(&trace->tail);
+		
+		/* nothing left to save */
+		if (head == tail)
+		{
+			if (SDL_AtomicGet(&trace->quit))
+				break;
+			SDL_SemWaitTimeout(trace->wake, TRACE_WAIT_MS);
+			continue;
+		}
+		
+		/* the events before `head` were filled in before it was published */
+		SDL_MemoryBarrierAcquire();
+		for ( ; tail != head; ++tail)
+			TraceWriteEvent(trace, &trace->event[tail & (TRACE_EVENTS - 1)]);
+		
+		/* and they're only reused once they've been written */
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&trace->tail, tail);
+	}
+	
+	return 0;
+}
+
+
+/******************************
+ *
+ * public functions
+ *
+ ******************************/
+
+/* start recording a trace, which is saved to `path` as it goes */
+struct Trace *TraceNew(const char *path)
+{
+	struct Trace *trace = calloc(1, sizeof(*trace));
+	
+	assert(path);
+	
+	if (!trace)
+		return 0;
+	
+	if (!(trace->event = malloc(TRACE_EVENTS * sizeof(*trace->event))))
+	{
+		free(trace);
+		return 0;
+	}
+	
+	trace->path = path;
+	if (!(trace->fp = fopen(path, "w")))
+		FlappyFatal("failed to open '%s' for writing", path);
+	/* the array format, which viewers still load if the closing ] is missing */
+	fputs("[\n", trace->fp);
+	
+	trace->freq = SDL_GetPerformanceFrequency();
+	trace->start = SDL_GetPerformanceCounter();
+	
+	if (!(trace->wake = SDL_CreateSemaphore(0)))
+		SDL_ERR("SDL_CreateSemaphore");
+	if (!(trace->thread = SDL_CreateThread(TraceThread, "trace", trace)))
+		SDL_ERR("SDL_CreateThread");
+	
+	return trace;
+}
+
+/* save what's left of a trace and deallocate it */
+void TraceFree(struct Trace *trace)
+{
+	assert(trace);
+	
+	SDL_AtomicSet(&trace->quit, 1);
+	SDL_SemPost(trace->wake);
+	SDL_WaitThread(trace->thread, 0);
+	SDL_DestroySemaphore(trace->wake);
+	
+	fputs("\n]\n", trace->fp);
+	if (fclose(trace->fp))
+		fprintf(stderr, "failed to write '%s'\n", trace->path);
+	
+	if (trace->dropped)
+		fprintf(stderr, "trace: %u events saved, %u dropped\n", trace->written, trace->dropped);
+	
+	free(trace->event);
+	free(trace);
+}
+
+/* record an event; `phase` is 'B' to begin a slice, 'E' to end it,
+ * or 'i' for an instant, which carries `value` as its argument
+ */
+void TracePush(struct Flappy *game, char phase, const char *cat, const char *name, int value)
+{
+	struct Trace *trace;
+	struct TraceEvent *ev;
+	unsigned head;
+	unsigned used;
+	unsigned need;
+	
+	assert(game);
+	assert(cat);
+	assert(name);
+	
+	if (!(trace = game->trace))
+		return;
+	
+	head = SDL_AtomicGet(&trace->head);
+	used = head - (unsigned)SDL_AtomicGet(&trace->tail);
+	SDL_MemoryBarrierAcquire();
+	
+	/* a slice whose begin was lost loses everything nested in it and
+	 * its end too, so every begin that's saved has a matching end
+	 */
+	if (trace->skip && phase != 'i')
+	{
+		if (phase == 'B')
+			trace->skip += 1;
+		else
+			trace->skip -= 1;
+		trace->dropped += 1;
+		return;
+	}
+	
+	/* room is kept for the end of every open slice, so ends always fit */
+	if (phase == 'E')
+	{
+		assert(trace->open);
+		trace->open -= 1;
+		need = 1;
+	}
+	else
+		need = 1 + trace->open + (phase == 'B');
+	
+	/* the writer fell behind; lose the event rather than wait */
+	if (used + need > TRACE_EVENTS)
+	{
+		if (phase == 'B')
+			trace->skip = 1;
+		trace->dropped += 1;
+		return;
+	}
+	if (phase == 'B')
+		trace->open += 1;
+	
+	ev = &trace->event[head & (TRACE_EVENTS - 1)];
+	ev->when = SDL_GetPerformanceCounter();
+	ev->cat = cat;
+	ev->name = name;
+	ev->value = value;
+	ev->phase = phase;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&trace->head, (int)(head + 1));
+	
+	/* only wake the writer early once the ring is half full */
+	if (used + 1 == TRACE_EVENTS / 2)
+		SDL_SemPost(trace->wake);
+}
+
+#endif /* FLAPPY_PROFILE */
@@ -10,85 +10,147 @@
 #define BTN_PLAY_OFS  2    /* amount to add to play button icon to make it center better */
 #define NEW_BLINK     1000 /* milliseconds for blinking 'New!' high score indicator */
 
-/* handles both processing and drawing a clickable interface button */
-void UiDrawButton(struct Flappy *game, int x, int y, enum FlappyButton icon)
+#define UI_BUTTON_ROW  0    /* row in ui.png containing button sprites */
+#define UI_BUTTON_COL  1    /* column of unpressed button; pressed follows */
+#define UI_BUTTON_MAX  3    /* most buttons on any one screen */
+#define UI_COLOR       0x9dd47d /* rgb888 button color */
+#define UI_COLOR_STEP  0x202020 /* brighter on hover, darker when pressed */
+#define UI_CURSOR_ROW  1    /* cursor sprite in ui.png */
+#define UI_CURSOR_COL  5
+
+struct UiButton
+{
+	int                 x;         /* center */
+	int                 y;
+	enum FlappyButton   icon;
+	SDL_Rect            rect;      /* clickable area */
+	SDL_Color           color;     /* cached visual state */
+	unsigned            pressed:1;
+};
+
+/* the buttons making up one FlappyState's screen */
+struct UiScreen
+{
+	struct UiButton     button[UI_BUTTON_MAX];
+	int                 buttonNum;
+	SDL_Rect            bounds;    /* encloses every button */
+	int                 drawnHover; /* hover and press as of the last */
+	int                 drawnPress; /* time the visual state was cached */
+};
+
+struct UiState
+{
+	struct UiScreen     screen[FLAPPY_STATE_MAX];
+	enum FlappyState    state;     /* screen the indices below refer to */
+	int                 hover;     /* button under the cursor (-1 = none) */
+	int                 press;     /* button being clicked (-1 = none) */
+	SDL_Cursor         *cursor;    /* hardware cursor (0 = draw it ourselves) */
+	unsigned            cursorScale; /* scale the cursor was built at */
+};
+
+/* where each screen's buttons go */
+static const struct
+{
+	enum FlappyState    state;
+	int                 x;
+	int                 y;
+	enum FlappyButton   icon;
+} UiLayout[] = {
+	{ FLAPPY_STATE_TITLE, WINDOW_W / 2 - 24, 80, FLAPPY_BUTTON_PLAY }
+	, { FLAPPY_STATE_TITLE, WINDOW_W / 2 + 24, 80, FLAPPY_BUTTON_THEME }
+	, { FLAPPY_STATE_PLAYING, 23, WINDOW_H - 17, FLAPPY_BUTTON_PAUSE }
+	, { FLAPPY_STATE_PLAYING, WINDOW_W - 23, WINDOW_H - 17, FLAPPY_BUTTON_THEME }
+	, { FLAPPY_STATE_GAMEOVER, WINDOW_W / 2 + 48, 95, FLAPPY_BUTTON_RETRY }
+	, { FLAPPY_STATE_GAMEOVER, WINDOW_W / 2, 95, FLAPPY_BUTTON_THEME }
+	, { FLAPPY_STATE_GAMEOVER, WINDOW_W / 2 - 48, 95, FLAPPY_BUTTON_QUIT }
+};
+
+/* returns the screen whose buttons are currently shown, if any */
+static struct UiScreen *UiGetScreen(struct Flappy *game)
 {
-	/* rgb888 button color list */
-	enum FlappyMouse mouse;
-	SDL_Rect rect;
-	uint32_t color = 0x9dd47d;
-	uint8_t rOld, gOld, bOld;
-	uint8_t r, g, b;
-	int row = 0; /* which row in sprite sheet contains button sprites */
-	int sprite = 1; /* which sprite in row */
-	int clicking = 0; /* button using 'pressed' sprite */
-	int clicked;
-	
 	assert(game);
-	assert(game->theme < FLAPPY_THEME_MAX);
-	
-	rect = SpritesheetGetCentered(game, game->ui, row, sprite, x, y);
-	mouse = InputMouseInRect(game, rect);
-	if (mouse == (FLAPPY_MOUSE_CLICKING | FLAPPY_MOUSE_HOVERING))
-		color -= 0x202020;
-	else if (mouse & FLAPPY_MOUSE_HOVERING)
-		color += 0x202020;
-	if (mouse & FLAPPY_MOUSE_HOVERING)
-		game->buttonhover = 1;
-	
-	/* display clicked version of button */
-	if (mouse & FLAPPY_MOUSE_CLICKING)
+	assert(game->uiState);
+	
+	/* game over buttons appear after a delay */
+	if (game->state == FLAPPY_STATE_GAMEOVER && game->stateTicks < GAMEOVER_TIME)
+		return 0;
+	
+	return &game->uiState->screen[game->state];
+}
+
+/* returns which of the screen's buttons contains a point (-1 = none) */
+static int UiHitTest(const struct UiScreen *screen, int x, int y)
+{
+	int i;
+	
+	assert(screen);
+	
+	if (!CollisionPointRect(x, y, screen->bounds))
+		return -1;
+	
+	for (i = 0; i < screen->buttonNum; ++i)
+		if (CollisionPointRect(x, y, screen->button[i].rect))
+			return i;
+	
+	return -1;
+}
+
+/* cache how each button looks, given what the mouse is doing */
+static void UiCacheVisuals(struct UiState *ui, struct UiScreen *screen)
+{
+	int i;
+	
+	assert(ui);
+	assert(screen);
+	
+	for (i = 0; i < screen->buttonNum; ++i)
 	{
-		++y;
-		sprite += 1;
-		clicking = 1;
+		struct UiButton *button = &screen->button[i];
+		uint32_t color = UI_COLOR;
+		
+		if (i == ui->hover && i == ui->press)
+			color -= UI_COLOR_STEP;
+		else if (i == ui->hover)
+			color += UI_COLOR_STEP;
+		
+		button->color = (SDL_Color){color >> 16, color >> 8, color, 0xff};
+		button->pressed = (i == ui->press);
 	}
-	r = color >> 16;
-	g = color >>  8;
-	b = color;
-	
-	/* draw button with color */
-	SDL_GetTextureColorMod(SpritesheetGetTexture(game->ui), &rOld, &gOld, &bOld);
-	SDL_SetTextureColorMod(SpritesheetGetTexture(game->ui), r, g, b);
-	SpritesheetDrawCentered(game, game->ui, row, sprite, x, y);
-	SDL_SetTextureColorMod(SpritesheetGetTexture(game->ui), rOld, gOld, bOld);
-	
-	/* draw icon on button */
-	clicked = mouse & FLAPPY_MOUSE_CLICKED;
-	if (!clicking) /* if button not using 'pressed' sprite, shift sprite up */
-		y -= 1;
+	
+	screen->drawnHover = ui->hover;
+	screen->drawnPress = ui->press;
+}
+
+/* the game cursor is less distracting if it's smaller than other UI elements */
+static unsigned UiGetCursorScale(struct Flappy *game)
+{
+	assert(game);
+	
+	return game->scale / 2 ? game->scale / 2 : 1;
+}
+
+/* perform a button's action */
+static void UiButtonClicked(struct Flappy *game, enum FlappyButton icon)
+{
+	assert(game);
+	
 	switch (icon)
 	{
 		case FLAPPY_BUTTON_PAUSE:
-			if (game->paused)
-				SpritesheetDrawCentered(game, game->ui, 1, 0, x + BTN_PLAY_OFS, y);
-			else
-				SpritesheetDrawCentered(game, game->ui, 1, 1, x, y);
-			if (clicked)
-				FlappyGamePause(game);
+			FlappyGamePause(game);
 			break;
+		
 		case FLAPPY_BUTTON_PLAY:
-			SpritesheetDrawCentered(game, game->ui, 1, 0, x + BTN_PLAY_OFS, y);
-			if (clicked)
-				FlappyStartGame(game);
+		case FLAPPY_BUTTON_RETRY:
+			FlappyStartGame(game);
 			break;
 		
 		case FLAPPY_BUTTON_THEME:
-			SpritesheetDrawCentered(game, game->ui, 1, 2, x, y);
-			if (clicked)
-				FlappyNextTheme(game);
-			break;
-		
-		case FLAPPY_BUTTON_RETRY:
-			SpritesheetDrawCentered(game, game->ui, 1, 3, x, y);
-			if (clicked)
-				FlappyStartGame(game);
+			FlappyNextTheme(game);
 			break;
 		
 		case FLAPPY_BUTTON_QUIT:
-			SpritesheetDrawCentered(game, game->ui, 1, 4, x, y);
-			if (clicked)
-				FlappyGoTitle(game);
+			FlappyGoTitle(game);
 			break;
 		
 		case FLAPPY_BUTTON_MAX:
@@ -96,49 +158,313 @@ void UiDrawButton(struct Flappy *game, int x, int y, enum FlappyButton icon)
 	}
 }
 
-/* display a score */
-int UiDrawScore(struct Flappy *game, unsigned score, int x, int y, int display)
+/* draw the current screen's buttons as last updated */
+static void UiDrawButtons(struct Flappy *game)
 {
-	const char *c;
-	char str[32];
-	int totalWidth = 0;
+	struct UiScreen *screen;
+	struct UiState *ui;
+	SDL_Color old;
+	int i;
 	
 	assert(game);
 	
+	ui = game->uiState;
+	if (!(screen = UiGetScreen(game)))
+		return;
+	
+	/* screen changed since the mouse was last checked */
+	if (ui->state != game->state)
+	{
+		ui->state = game->state;
+		ui->hover = ui->press = -1;
+	}
+	
+	if (ui->hover != screen->drawnHover || ui->press != screen->drawnPress)
+		UiCacheVisuals(ui, screen);
+	
+	old = BatchGetColor(game);
+	for (i = 0; i < screen->buttonNum; ++i)
+	{
+		const struct UiButton *button = &screen->button[i];
+		int x = button->x;
+		int y = button->y + button->pressed;
+		
+		/* button with color */
+		BatchSetColor(game, button->color.r, button->color.g, button->color.b, old.a);
+		SpritesheetDrawCentered(game, game->ui, UI_BUTTON_ROW, UI_BUTTON_COL + button->pressed, x, y);
+		BatchSetColor(game, old.r, old.g, old.b, old.a);
+		
+		/* icon on button, shifted up unless using 'pressed' sprite */
+		if (!button->pressed)
+			y -= 1;
+		switch (button->icon)
+		{
+			case FLAPPY_BUTTON_PAUSE:
+				if (game->paused)
+					SpritesheetDrawCentered(game, game->ui, 1, 0, x + BTN_PLAY_OFS, y);
+				else
+					SpritesheetDrawCentered(game, game->ui, 1, 1, x, y);
+				break;
+			
+			case FLAPPY_BUTTON_PLAY:
+				SpritesheetDrawCentered(game, game->ui, 1, 0, x + BTN_PLAY_OFS, y);
+				break;
+			
+			case FLAPPY_BUTTON_THEME:
+				SpritesheetDrawCentered(game, game->ui, 1, 2, x, y);
+				break;
+			
+			case FLAPPY_BUTTON_RETRY:
+				SpritesheetDrawCentered(game, game->ui, 1, 3, x, y);
+				break;
+			
+			case FLAPPY_BUTTON_QUIT:
+				SpritesheetDrawCentered(game, game->ui, 1, 4, x, y);
+				break;
+			
+			case FLAPPY_BUTTON_MAX:
+				break;
+		}
+	}
+}
+
+/* returns the space a score digit takes up, in sprite pixels;
+ * the narrower '1' is packed tighter
+ */
+static int UiDigitWidth(unsigned digit)
+{
+	return (digit == 1 ? 10 : 15) + 2;
+}
+
+/* lay out `score` into `ui`, if it isn't already */
+static const struct UiScore *UiScoreLayout(struct UiScore *ui, unsigned score)
+{
+	unsigned n;
+	int i;
+	
+	assert(ui);
+	
 	if (score > 9999)
 		score = 9999;
 	
-	snprintf(str, sizeof(str), "%d", score);
+	if (ui->valid && ui->value == score)
+		return ui;
+	
+	ui->value = score;
+	ui->valid = 1;
+	
+	/* digits, most significant first */
+	for (ui->digitNum = 1, n = score; n >= 10; n /= 10)
+		ui->digitNum += 1;
+	for (i = ui->digitNum - 1, n = score; i >= 0; --i, n /= 10)
+		ui->digit[i] = n % 10;
+	
+	ui->width = 0;
+	for (i = 0; i < ui->digitNum; ++i)
+	{
+		ui->x[i] = ui->width;
+		ui->width += UiDigitWidth(ui->digit[i]);
+	}
+	
+	return ui;
+}
+
+/* display a score laid out by UiScoreLayout() */
+static void UiDrawScore(struct Flappy *game, const struct UiScore *ui, int x, int y)
+{
+	int i;
+	
+	assert(game);
+	assert(ui);
+	
+	for (i = 0; i < ui->digitNum; ++i)
+		SpritesheetDraw(game, game->ui, 1, 6 + ui->digit[i], x + ui->x[i], y);
+}
+
+/* draw `value` with the score digits at window resolution, `scale`
+ * window pixels per sprite pixel, with its top left corner at window
+ * pixel `x`, `y`; returns its width; unlike scores, it isn't capped
+ */
+int UiDrawNumber(struct Flappy *game, unsigned value, int x, int y, float scale)
+{
+	uint8_t digit[10]; /* enough for any unsigned, least significant first */
+	int digitNum = 0;
+	int width = 0;
+	
+	assert(game);
+	
+	do
+		digit[digitNum++] = value % 10;
+	while (value /= 10);
 	
-	for (c = str; *c; ++c)
+	while (digitNum--)
 	{
-		int w;
+		SpritesheetDrawScaled(game, game->ui, 1, 6 + digit[digitNum]
+			, (x + width * scale) / game->scale
+			, (float)y / game->scale
+			, scale
+		);
+		width += UiDigitWidth(digit[digitNum]);
+	}
+	
+	return width * scale;
+}
+
+/* allocate the retained user interface, with each screen's buttons
+ * laid out up front; ui.png must already be loaded
+ */
+struct UiState *UiNew(struct Flappy *game)
+{
+	struct UiState *ui = calloc(1, sizeof(*ui));
+	unsigned i;
+	
+	assert(game);
+	assert(game->ui);
+	
+	if (!ui)
+		return 0;
+	
+	for (i = 0; i < ARRAY_COUNT(UiLayout); ++i)
+	{
+		struct UiScreen *screen = &ui->screen[UiLayout[i].state];
+		struct UiButton *button = &screen->button[screen->buttonNum++];
 		
-		if (*c == '1')
-			w = 10;
-		else
-			w = 15;
+		assert(screen->buttonNum <= UI_BUTTON_MAX);
 		
-		if (display)
-			SpritesheetDraw(game, game->ui, 1, 6 + (*c - '0'), x + totalWidth, y);
+		button->x = UiLayout[i].x;
+		button->y = UiLayout[i].y;
+		button->icon = UiLayout[i].icon;
+		button->rect = SpritesheetGetCentered(game, game->ui, UI_BUTTON_ROW, UI_BUTTON_COL, button->x, button->y);
 		
-		totalWidth += w + 2;
+		if (screen->buttonNum == 1)
+			screen->bounds = button->rect;
+		else
+			SDL_UnionRect(&screen->bounds, &button->rect, &screen->bounds);
 	}
 	
-	return totalWidth;
+	ui->hover = ui->press = -1;
+	for (i = 0; i < FLAPPY_STATE_MAX; ++i)
+		UiCacheVisuals(ui, &ui->screen[i]);
+	
+	return ui;
+}
+
+/* deallocate the retained user interface */
+void UiFree(struct UiState *ui)
+{
+	assert(ui);
+	
+	if (ui->cursor)
+		SDL_FreeCursor(ui->cursor);
+	free(ui);
+}
+
+/* build a hardware cursor from the cursor sprite at the current window
+ * scale, so it moves with the mouse instead of with the frame rate;
+ * if that isn't possible, UiDrawCursor() draws the sprite instead
+ */
+void UiSetCursor(struct Flappy *game)
+{
+	struct UiState *ui;
+	const uint32_t *atlas;
+	uint32_t *pix;
+	SDL_Surface *surf;
+	SDL_Cursor *cursor;
+	SDL_Rect clip;
+	unsigned scale;
+	int atlasW;
+	int w;
+	int h;
+	int x;
+	int y;
+	
+	assert(game);
+	assert(game->uiState);
+	
+	ui = game->uiState;
+	scale = UiGetCursorScale(game);
+	
+	if (ui->cursor && ui->cursorScale == scale)
+		return;
+	
+	/* nearest neighbor upscale, straight from the atlas */
+	clip = SpritesheetGetClip(game, game->ui, UI_CURSOR_ROW, UI_CURSOR_COL);
+	atlas = AtlasGetPixels(game->atlas, &atlasW, 0);
+	w = clip.w * scale;
+	h = clip.h * scale;
+	if (!(pix = malloc(w * h * sizeof(*pix))))
+		FlappyFatal("memory error");
+	for (y = 0; y < h; ++y)
+		for (x = 0; x < w; ++x)
+			pix[y * w + x] = atlas[(clip.y + y / scale) * atlasW + clip.x + x / scale];
+	surf = SurfaceFromPixels(game, pix, w, h);
+	free(pix);
+	
+	/* the sprite is drawn with its top left corner at the cursor */
+	cursor = SDL_CreateColorCursor(surf, 0, 0);
+	SDL_FreeSurface(surf);
+	
+	if (cursor)
+		SDL_SetCursor(cursor);
+	if (ui->cursor)
+		SDL_FreeCursor(ui->cursor);
+	ui->cursor = cursor;
+	ui->cursorScale = scale;
+	SDL_ShowCursor(cursor != 0);
 }
 
-/* get width (in pixels) of the score counter */
-int UiGetScorePixelWidth(struct Flappy *game, unsigned score)
+/* find the buttons under the cursor and perform any that were clicked;
+ * this runs once per frame after input is gathered, so gameplay knows
+ * whether the cursor is over a button before it reacts to clicks
+ */
+void UiUpdate(struct Flappy *game)
 {
-	return UiDrawScore(game, score, 0, 0, 0);
+	struct UiScreen *screen;
+	struct UiState *ui;
+	struct Input *input;
+	
+	assert(game);
+	assert(game->uiState);
+	
+	ui = game->uiState;
+	input = &game->input;
+	
+	ui->state = game->state;
+	ui->hover = ui->press = -1;
+	
+	if (!(screen = UiGetScreen(game)))
+		return;
+	
+	ui->hover = UiHitTest(screen, input->mouseX, input->mouseY);
+	if (input->mouseDown)
+		ui->press = UiHitTest(screen, input->clickX, input->clickY);
+	
+	/* a press that lands on a button is for the button alone */
+	if (ui->press >= 0)
+		input->pressed = 0;
+	
+	/* released over the same button it was pressed on */
+	if (input->clicked && ui->press >= 0 && ui->press == ui->hover)
+	{
+		input->clicked = 0;
+		input->mouseDown = 0;
+		UiButtonClicked(game, screen->button[ui->press].icon);
+	}
+}
+
+/* returns nonzero if the cursor is over a button, as of the last UiUpdate() */
+int UiIsHovering(struct Flappy *game)
+{
+	assert(game);
+	assert(game->uiState);
+	
+	return game->uiState->hover >= 0;
 }
 
 /* draw the game's user interface during the 'title' game state */
 void UiDrawTitle(struct Flappy *game)
 {
 	int winCenterX = WINDOW_W / 2;
-	int buttonY = 80;
 	
 	assert(game);
 	
@@ -148,30 +474,23 @@ void UiDrawTitle(struct Flappy *game)
 	/* author */
 	SpritesheetDrawCentered(game, game->ui, 2, 0, winCenterX, WINDOW_H - 11);
 	
-	/* play button */
-	UiDrawButton(game, winCenterX - 24, buttonY, FLAPPY_BUTTON_PLAY);
-	
-	/* theme button */
-	UiDrawButton(game, winCenterX + 24, buttonY, FLAPPY_BUTTON_THEME);
+	/* play and theme buttons */
+	UiDrawButtons(game);
 }
 
 /* draw the game's user interface during the 'playing' game state */
 void UiDrawPlaying(struct Flappy *game)
 {
-	int width;
-	int buttonY = WINDOW_H - 17;
+	const struct UiScore *score;
 	
 	assert(game);
 	
 	/* score */
-	width = UiGetScorePixelWidth(game, game->score);
-	UiDrawScore(game, game->score, WINDOW_W - (width + 15), 15, 1);
+	score = UiScoreLayout(&game->scoreUi, game->score);
+	UiDrawScore(game, score, WINDOW_W - (score->width + 15), 15);
 	
-	/* pause button */
-	UiDrawButton(game, 23, buttonY, FLAPPY_BUTTON_PAUSE);
-	
-	/* theme button */
-	UiDrawButton(game, WINDOW_W - 23, buttonY, FLAPPY_BUTTON_THEME);
+	/* pause and theme buttons */
+	UiDrawButtons(game);
 	
 	/* 'paused' overlay */
 	if (game->paused)
@@ -188,8 +507,8 @@ void UiDrawPlaying(struct Flappy *game)
 void UiDrawGameOver(struct Flappy *game)
 {
 	int winCenterX = WINDOW_W / 2;
-	int buttonY = 95;
 	int scoreX = winCenterX + 57;
+	const struct UiScore *score;
 	
 	assert(game);
 	
@@ -202,39 +521,26 @@ void UiDrawGameOver(struct Flappy *game)
 	
 	/* score */
 	SpritesheetDraw(game, game->ui, 2, 2, winCenterX - 57, 32);
-	UiDrawScore(game, game->score, scoreX - UiGetScorePixelWidth(game, game->score), 32, 1);
+	score = UiScoreLayout(&game->scoreUi, game->score);
+	UiDrawScore(game, score, scoreX - score->width, 32);
 	
 	/* best */
 	SpritesheetDraw(game, game->ui, 0, 4, winCenterX - 57, 57);
-	UiDrawScore(game, game->highscore, scoreX - UiGetScorePixelWidth(game, game->highscore), 57, 1);
+	score = UiScoreLayout(&game->highscoreUi, game->highscore);
+	UiDrawScore(game, score, scoreX - score->width, 57);
 	/* new! */
 	if (game->highscoreNew && ((game->stateTicks - GAMEOVER_TIME) % (NEW_BLINK * 2)) < NEW_BLINK)
 		SpritesheetDraw(game, game->ui, 2, 4, scoreX + 2, 57);
 	
-	/* retry button */
-	UiDrawButton(game, winCenterX + 48, buttonY, FLAPPY_BUTTON_RETRY);
-	
-	/* theme button */
-	UiDrawButton(game, winCenterX, buttonY, FLAPPY_BUTTON_THEME);
-	
-	/* quit button */
-	UiDrawButton(game, winCenterX - 48, buttonY, FLAPPY_BUTTON_QUIT);
+	/* retry, theme, and quit buttons */
+	UiDrawButtons(game);
 }
 
 /* draw the game's user interface */
 void UiDraw(struct Flappy *game)
 {
-	unsigned cursorScale = 1;
-	
 	assert(game);
 	
-	/* every UI redraw, this says "no buttons being hovered",
-	 * and then as buttons are drawn, its value is updated,
-	 * and by the end of the function, it is known whether
-	 * the cursor is hovering over any UI buttons
-	 */
-	game->buttonhover = 0;
-	
 	switch (game->state)
 	{
 		case FLAPPY_STATE_TITLE:
@@ -252,11 +558,22 @@ void UiDraw(struct Flappy *game)
 		case FLAPPY_STATE_MAX:
 			break;
 	}
+}
+
+/* draw the game cursor, if there's no hardware cursor; this happens after
+ * the frame has been upscaled to the window, which allows the cursor to be
+ * drawn at a finer scale
+ */
+void UiDrawCursor(struct Flappy *game)
+{
+	assert(game);
+	assert(game->uiState);
+	
+	if (game->uiState->cursor)
+		return;
 	
-	/* the game cursor is less distracting if it's smaller than other UI elements */
-	cursorScale = game->scale / 2;
-	if (!cursorScale)
-		cursorScale = 1;
-	SpritesheetDrawScaled(game, game->ui, 1, 5, game->input.mouseX, game->input.mouseY, cursorScale);
+	SpritesheetDrawScaled(game, game->ui, UI_CURSOR_ROW, UI_CURSOR_COL
+		, game->input.mouseX, game->input.mouseY, UiGetCursorScale(game)
+	);
 }
 
@@ -29,22 +29,29 @@ static float JabuHazardEaseOut(float p)
 	return sin((p - 1) * M_PI_2) + 1;
 }
 
-static float JabuHazardHeight(struct Flappy *game)
+/* returns the hazard's height `themeTicks` into the theme and `stateTicks`
+ * into the state; if `active` isn't 0, it's set if the hazard is rising
+ * or about to
+ */
+static float JabuHazardHeight(struct Flappy *game, uint32_t themeTicks, uint32_t stateTicks, unsigned *active)
 {
 	uint32_t ticks;
 	float lo = WINDOW_H;
 	float hi = 48;
 	float diff = lo - hi;
+	unsigned dummy;
 	
-	game->jabuHazardActive = 0;
+	if (!active)
+		active = &dummy;
+	*active = 0;
 	
 	/* game over screen seamless logic */
 	if (game->state == FLAPPY_STATE_GAMEOVER)
-		ticks = game->themeTicks;
+		ticks = themeTicks;
 	
 	/* regular gameplay */
 	else if (game->state == FLAPPY_STATE_PLAYING)
-		ticks = fmin(game->themeTicks, game->stateTicks);
+		ticks = fmin(themeTicks, stateTicks);
 	
 	/* ignore hazard on any other screen */
 	else
@@ -58,7 +65,7 @@ static float JabuHazardHeight(struct Flappy *game)
 	{
 		/* stage hazard predictor */
 		if (ticks >= JABU_FREQ / 2)
-			game->jabuHazardActive = 1;
+			*active = 1;
 		
 		return lo;
 	}
@@ -75,7 +82,7 @@ static float JabuHazardHeight(struct Flappy *game)
 		return hi + diff * JabuHazardEaseOut(((float)ticks - (JABU_SPEED + JABU_TIME)) / JABU_SPEED);
 	
 	/* rising */
-	game->jabuHazardActive = 1;
+	*active = 1;
 	return lo - diff * JabuHazardEaseIn((float)ticks / JABU_SPEED);
 }
 
@@ -91,7 +98,7 @@ static void JabuHazard(struct Flappy *game)
 	#define JABU_WIDTH   200  /* hazard frame width */
 	#define JABU_HEIGHT  112  /* hazard frame height */
 	
-	index = (game->ticks / 100) % 8;
+	index = (FlappyGetDrawTicks(game, 0) / 100) % 8;
 	
 	/* derive clipping rectangle */
 	clip.x = JABU_WIDTH * index;
@@ -100,8 +107,13 @@ static void JabuHazard(struct Flappy *game)
 	clip.w = JABU_WIDTH;
 	clip.h = JABU_HEIGHT;
 	
-	SDL_SetTextureAlphaMod(game->jabu, 0x95);
-	TextureDraw(game, game->jabu, clip, 0, JabuHazardHeight(game));
+	BatchSetColor(game, 0xff, 0xff, 0xff, 0x95);
+	ImageDraw(game, game->jabu, clip, 0, JabuHazardHeight(game
+		, FlappyGetDrawTicks(game, game->themeStartTime)
+		, FlappyGetDrawTicks(game, game->stateStartTime)
+		, 0
+	));
+	BatchSetColor(game, 0xff, 0xff, 0xff, 0xff);
 	
 	#undef JABU_STRIDE
 	#undef JABU_WIDTH
@@ -120,7 +132,11 @@ void WorldDoHazards(struct Flappy *game)
 {
 	/* jabu hazard hitbox */
 	if (game->theme == FLAPPY_THEME_JABU)
-		ColliderArenaPush(game, 0, 0, COLOR_WORLD, ColliderInitRect(game, 0, JabuHazardHeight(game) + 4, WINDOW_W, WINDOW_H));
+	{
+		float y = JabuHazardHeight(game, game->themeTicks, game->stateTicks, &game->jabuHazardActive);
+		
+		ColliderArenaPush(game, 0, 0, COLOR_WORLD, ColliderInitRect(game, 0, y + 4, WINDOW_W, WINDOW_H));
+	}
 }
 
 /* draw the game world */